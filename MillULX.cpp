@@ -43,20 +43,61 @@ These are property of Mill Computing, Inc.
 */
 
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
 #include <pthread.h>
+#include <sched.h>
+#include <climits>
+#include <cstddef>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
 
 typedef long long BELT_T;
 typedef unsigned int MEM_T;
 
-static const size_t BELT_SIZE = 32U; // If you change this, BAD! things will happen.
-static const size_t ALUNITS = 2U;
+// The slots of each belt: 8, 16 or 32, as MILL_BELT_SIZE says. An operand is a bit for the belt (OPERAND_SLOW) over a
+// five bit position, and the top two positions are the constants, so a belt deeper than 32 couldn't be reached.
+#ifndef MILL_BELT_SIZE
+#define MILL_BELT_SIZE 32
+#endif
+static const size_t BELT_SIZE = MILL_BELT_SIZE;
+static const size_t BELT_MASK = BELT_SIZE - 1U; // Each belt is a ring.
+static const size_t OPERAND_POSITION = 0x1FU;
+static const size_t OPERAND_SLOW = 0x20U;
+static const size_t OPERAND_CONSTANTS = OPERAND_POSITION - 1U; // This position and the one after it
+static_assert((BELT_SIZE >= 8U) && (BELT_SIZE <= OPERAND_POSITION + 1U) && (0U == (BELT_SIZE & BELT_MASK)),
+   "MILL_BELT_SIZE must be 8, 16 or 32");
+// Cores and checkpoints hold the belts slot for slot, so with a shorter belt they are tagged with its size.
+static const char * const CORE_TAG = (32U == BELT_SIZE) ? "Core" : ((16U == BELT_SIZE) ? "Co16" : "Co08");
+static const char * const DELTA_TAG = (32U == BELT_SIZE) ? "Delt" : ((16U == BELT_SIZE) ? "De16" : "De08");
+// The ALU slots in a cycle: an image says which width it was scheduled for. The engines are templates on it,
+// instantiated for each of ALU_WIDTHS; the machine's storage is sized for the widest.
+static const size_t ALU_WIDTHS [3] = { 2U, 4U, 8U };
+static const size_t MAX_ALUNITS = 8U;
+static const size_t DEFAULT_ALUNITS = 2U; // For an image that doesn't say
 static const size_t ALU_RETIRE_SIZE = 2U;
 static const size_t FLOW_UNITS = 1U;
-static const size_t FLOW_RETIRE_SIZE = BELT_SIZE;
-// A not-taken call with a full belt of returns requires this.
+static const size_t FLOW_RETIRE_SIZE = OPERAND_POSITION + 1U;
+// A not-taken call with its most returns (a five bit count) requires this, whatever the size of the belt.
 
 static const BELT_T TRANSIENT =  0x200000000LL;
 static const BELT_T INVALID   =  0x400000000LL;
@@ -67,12 +108,65 @@ static const BELT_T EMPTY     = 0x2000000000LL;
 static const BELT_T CARRY     =  0x100000000LL;
 static const BELT_T NEGATIVE  =   0x80000000LL;
 
+// Bits of what the gestalt interrupt returns.
+static const BELT_T GESTALT_BULK_IO = 0x1LL; // Interrupts 5 and 6
+static const BELT_T GESTALT_POLL_IO = 0x2LL; // Interrupts 7 and 8
+static const BELT_T GESTALT_MEMORY = 0x4LL; // Interrupts 9 through 12
+static const BELT_T GESTALT_COUNTERS = 0x8LL; // Gestalt selector 1
+static const BELT_T GESTALT_PACKED = 0x10LL; // ALU opcodes 16 through 21
+#ifdef MILL_STATS
+static const BELT_T GESTALT = GESTALT_BULK_IO | GESTALT_POLL_IO | GESTALT_MEMORY | GESTALT_COUNTERS | GESTALT_PACKED;
+#else
+static const BELT_T GESTALT = GESTALT_BULK_IO | GESTALT_POLL_IO | GESTALT_MEMORY | GESTALT_PACKED;
+#endif
+
+// Dispatch through a table of label addresses where the compiler allows it, and a switch where it doesn't.
+#if defined(__GNUC__) && !defined(MILL_NO_COMPUTED_GOTO)
+#define MILL_COMPUTED_GOTO
+#endif
+
+// Compile hot traces to native code where we know how. The compiled code reads belt slots as BELT_T,
+// and retires cycles without counting what is in them.
+#if defined(__x86_64__) && !defined(MILL_NO_JIT) && !defined(MILL_SOA_BELT) && !defined(MILL_STATS)
+#define MILL_JIT
+static const size_t JIT_THRESHOLD = 32U; // Entries before a trace is compiled
+#endif
+
+// Vector kernels for comparing and scanning memory. SSE2 is always there on x86-64; AVX2 is looked for at run time.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__) && !defined(MILL_NO_SIMD)
+#define MILL_SIMD
+#include <immintrin.h>
+#endif
+
 static const char* endian()
  {
    const short var = 0x454C;
    return (0 == std::strncmp("LE", static_cast<const char*>(static_cast<const void*>(&var)), 2U)) ? "LE" : "BE";
  }
 
+// In a "Page" image, the words of a block start at the first file offset that is congruent to
+// their address in memory, modulo IMAGE_PAGE. The loader can then map them instead of copying them.
+static const size_t IMAGE_PAGE = 4096U;
+
+static size_t imageAlign(size_t offset, size_t address)
+ {
+   return offset + ((address * sizeof(MEM_T) - offset) % IMAGE_PAGE);
+ }
+
+static void imagePad(std::FILE * file, size_t address)
+ {
+   const size_t at = static_cast<size_t>(std::ftell(file));
+   for (size_t pad = imageAlign(at, address) - at; pad > 0U; --pad)
+    {
+      std::fputc(0, file);
+    }
+ }
+
+// Checkpoints and snapshots track stores by the page of the image they land in.
+static const size_t PAGE_WORDS = IMAGE_PAGE / sizeof(MEM_T);
+static const unsigned char SINCE_CHECKPOINT = 1U;
+static const unsigned char SINCE_SNAPSHOT = 2U;
+
 enum FlowBeltUse
  {
    NOT_IN_USE, // Because SOMEONE is probably using UNUSED
@@ -174,12 +268,72 @@ public:
     }
  };
 
+// The slots of a belt. Normally each is a BELT_T. Built with MILL_SOA_BELT, the 32 bit payloads
+// and the metadata bits above them live in separate arrays, which takes 160 bytes instead of 256.
+class Belt
+ {
+public:
+#ifdef MILL_SOA_BELT
+   unsigned int value [BELT_SIZE];
+   unsigned char flags [BELT_SIZE]; // Bits 32 through 37 of the BELT_T: CARRY up to EMPTY
+
+   BELT_T get(size_t location) const
+    {
+      return static_cast<BELT_T>(value[location]) | (static_cast<BELT_T>(flags[location]) << 32);
+    }
+
+   void set(size_t location, BELT_T content)
+    {
+      value[location] = static_cast<unsigned int>(content);
+      flags[location] = static_cast<unsigned char>(content >> 32);
+    }
+
+   // Cores hold belts as BELT_T either way.
+   void read(std::FILE * file)
+    {
+      BELT_T slots [BELT_SIZE];
+      std::fread(static_cast<void*>(slots), sizeof(BELT_T), BELT_SIZE, file);
+      for (size_t i = 0U; i < BELT_SIZE; ++i) set(i, slots[i]);
+    }
+#else
+   BELT_T slot [BELT_SIZE];
+
+   BELT_T get(size_t location) const { return slot[location]; }
+   void set(size_t location, BELT_T content) { slot[location] = content; }
+
+   void read(std::FILE * file)
+    {
+      std::fread(static_cast<void*>(slot), sizeof(BELT_T), BELT_SIZE, file);
+    }
+#endif
+
+   // Only the first size slots from the front are ever written: the rest are INVALID, but for the
+   // constants, if the belt is long enough to have slots where they are named. Fill them in as they read.
+   void write(std::FILE * file, size_t front, size_t size, BELT_T zero, BELT_T one) const
+    {
+      BELT_T slots [BELT_SIZE];
+      for (size_t i = 0U; i < BELT_SIZE; ++i)
+       {
+         size_t location = (i - front) & BELT_MASK;
+         if (location >= OPERAND_CONSTANTS)
+          {
+            slots[i] = (OPERAND_CONSTANTS == location) ? zero : one;
+          }
+         else
+          {
+            slots[i] = (location < size) ? get(i) : INVALID;
+          }
+       }
+      std::fwrite(static_cast<void*>(slots), sizeof(BELT_T), BELT_SIZE, file);
+    }
+ };
+
 class Frame
  {
 public:
    // ALU/FLOW read-only
-   BELT_T fast [BELT_SIZE];
-   BELT_T slow [BELT_SIZE];
+   Belt fast;
+   Belt slow;
    size_t ffront, fsize; // The front and size of the fast belt
    size_t sfront, ssize; // The front and size of the slow belt
    size_t alunop;
@@ -190,14 +344,9 @@ public:
    size_t nextpc; // The winning branch instruction.
    size_t index; // For a call, the flow unit that initiated it.
 
-   // ALU/FLOW write-only
-   ALURetire alu_retire [ALUNITS];
-   FlowRetire flow_retire [FLOW_UNITS];
-
+   // The belts are left alone: nothing past a belt's size is read, and the constants aren't stored.
    void init (void)
     {
-      for (size_t i = 0U; i < BELT_SIZE; ++i) fast[i] = INVALID;
-      for (size_t i = 0U; i < BELT_SIZE; ++i) slow[i] = INVALID;
       ffront = 0U;
       fsize = 0U;
       sfront = 0U;
@@ -208,17 +357,13 @@ public:
       flowpc = 0U;
       entryPoint = 0U;
       nextpc = 0U;
-
-      fast[(ffront + 30) & 0x1F] = ZERO;
-      fast[(ffront + 31) & 0x1F] = 1;
-      slow[(sfront + 30) & 0x1F] = INVALID;
-      slow[(sfront + 31) & 0x1F] = TRANSIENT;
+      index = 0U;
     }
 
    void write(std::FILE * file)
     {
-      std::fwrite(static_cast<void*>(fast), sizeof(BELT_T), BELT_SIZE, file);
-      std::fwrite(static_cast<void*>(slow), sizeof(BELT_T), BELT_SIZE, file);
+      fast.write(file, ffront, fsize, ZERO, 1);
+      slow.write(file, sfront, ssize, INVALID, TRANSIENT);
       std::fwrite(static_cast<void*>(&ffront), sizeof(size_t), 1U, file); //std::printf("ffront %lu\n", ffront);
       std::fwrite(static_cast<void*>(&fsize), sizeof(size_t), 1U, file); //std::printf("fsize %lu\n", fsize);
       std::fwrite(static_cast<void*>(&sfront), sizeof(size_t), 1U, file);
@@ -230,14 +375,12 @@ public:
       std::fwrite(static_cast<void*>(&entryPoint), sizeof(size_t), 1U, file); //std::printf("entryPoint %lu\n", entryPoint);
       std::fwrite(static_cast<void*>(&nextpc), sizeof(size_t), 1U, file); //std::printf("nextpc %lu\n", nextpc);
       std::fwrite(static_cast<void*>(&index), sizeof(size_t), 1U, file);
-      for (size_t i = 0U; i < ALUNITS; ++i) alu_retire[i].write(file);
-      for (size_t i = 0U; i < FLOW_UNITS; ++i) flow_retire[i].write(file);
     }
 
    void read(std::FILE * file)
     {
-      std::fread(static_cast<void*>(fast), sizeof(BELT_T), BELT_SIZE, file);
-      std::fread(static_cast<void*>(slow), sizeof(BELT_T), BELT_SIZE, file);
+      fast.read(file);
+      slow.read(file);
       std::fread(static_cast<void*>(&ffront), sizeof(size_t), 1U, file);
       std::fread(static_cast<void*>(&fsize), sizeof(size_t), 1U, file);
       std::fread(static_cast<void*>(&sfront), sizeof(size_t), 1U, file);
@@ -249,1375 +392,6241 @@ public:
       std::fread(static_cast<void*>(&entryPoint), sizeof(size_t), 1U, file);
       std::fread(static_cast<void*>(&nextpc), sizeof(size_t), 1U, file);
       std::fread(static_cast<void*>(&index), sizeof(size_t), 1U, file);
-      for (size_t i = 0U; i < ALUNITS; ++i) alu_retire[i].read(file);
-      for (size_t i = 0U; i < FLOW_UNITS; ++i) flow_retire[i].read(file);
     }
  };
 
-class Machine
+// The call stack. Frames are handed out of fixed blocks, so they never move once they are pushed,
+// and calling or returning costs the same however deep the stack is.
+class FrameStack
  {
 public:
-   std::vector<Frame> frames;
-   MEM_T * memory;
-   size_t memsize;
-   bool terminate;
-   bool invalidOp;
-   bool stop;
+   static const size_t BLOCK = 64U;
+   std::vector<Frame*> blocks;
+   size_t count;
+   Frame* top;
 
-   Machine() : memory(NULL), memsize(0U), terminate(false), invalidOp(false), stop(false)
-    {
-      frames.push_back(Frame());
-    }
+   FrameStack() : count(0U), top(NULL) { }
 
-   void write(std::FILE * file)
+   ~FrameStack()
     {
-      std::fwrite(static_cast<void*>(&memsize), sizeof(size_t), 1U, file);
-      std::fwrite(static_cast<void*>(memory), sizeof(MEM_T), memsize, file);
-      size_t framesSize = frames.size();
-      std::fwrite(static_cast<void*>(&framesSize), sizeof(size_t), 1U, file);
-      for (size_t i = 0U; i < framesSize; ++i)
+      for (size_t i = 0U; i < blocks.size(); ++i)
        {
-         frames[i].write(file);
+         delete [] blocks[i];
        }
     }
 
-   void read(std::FILE * file)
+   size_t size() const { return count; }
+   Frame& operator [] (size_t i) { return blocks[i / BLOCK][i % BLOCK]; }
+   const Frame& operator [] (size_t i) const { return blocks[i / BLOCK][i % BLOCK]; }
+   Frame& back() { return *top; }
+   const Frame& back() const { return *top; }
+
+   // The new Frame still needs init().
+   Frame& push()
     {
-      std::fread(static_cast<void*>(&memsize), sizeof(size_t), 1U, file);
-      memory = new MEM_T [memsize];
-      std::fread(static_cast<void*>(memory), sizeof(MEM_T), memsize, file);
-      size_t framesSize;
-      std::fread(static_cast<void*>(&framesSize), sizeof(size_t), 1U, file);
-      frames.clear();
-      for (size_t i = 0U; i < framesSize; ++i)
+      if (count == blocks.size() * BLOCK)
        {
-         frames.push_back(Frame());
-         frames.back().read(file);
+         blocks.push_back(new Frame [BLOCK]);
        }
+      top = &(*this)[count];
+      ++count;
+      return *top;
+    }
+
+   void pop()
+    {
+      --count;
+      top = (0U != count) ? &(*this)[count - 1U] : NULL;
+    }
+
+   void clear()
+    {
+      count = 0U;
+      top = NULL;
     }
  };
 
-class FunctionalUnit
+// A record of the last so many events of the run, kept in a ring: the PCs at the start of each cycle,
+// the words stored to memory, and what each cycle dropped on the belts. It is written out at the end
+// of the run (a fault included) and on SIGUSR1, for TraceDump to print.
+class Recorder
  {
 public:
-   Machine* machine;
-   pthread_barrier_t* synchronizer;
-   size_t slot;
-   pthread_t thread;
+   enum Kind
+    {
+      CYCLE = 1, // a is alupc, b is flowpc << 32 | the low word of the cycle number
+      STORE = 2, // a is the word address, b the word stored
+      DROP_FAST = 3, // b is the value
+      DROP_SLOW = 4
+    };
 
-   virtual void doStuff() = 0;
+   class Record
+    {
+   public:
+      unsigned int kind;
+      unsigned int a;
+      unsigned long long b;
+    };
 
-   BELT_T getMemory(size_t location)
+   std::vector<Record> ring; // Its size is a power of two.
+   size_t mask;
+   size_t recorded; // Ever: the last of them are in the ring
+   static volatile sig_atomic_t requested;
+
+   Recorder() : mask(0U), recorded(0U) { }
+
+   static void onSignal(int)
     {
-      if (location >= machine->memsize)
-       {
-         return INVALID;
-       }
-      return machine->memory[location];
+      requested = 1;
     }
 
-   BELT_T setMemory(size_t location, MEM_T value)
+   // Keep the last (at least) count records.
+   void start(size_t count)
     {
-      if (location >= machine->memsize)
+      size_t size = 1U;
+      while (size < count)
        {
-         return INVALID;
+         size <<= 1;
        }
-      machine->memory[location] = value;
-      return 0U;
+      ring.resize(size);
+      mask = size - 1U;
+      struct sigaction action;
+      std::memset(static_cast<void*>(&action), 0, sizeof(action));
+      action.sa_handler = onSignal;
+      action.sa_flags = SA_RESTART;
+      sigaction(SIGUSR1, &action, NULL);
     }
 
-   static BELT_T getBeltContent(Frame& frame, size_t beltLocation)
+   void add(unsigned int kind, size_t a, unsigned long long b)
     {
-      if (0U == (beltLocation & 0x20))
-       {
-         if ((beltLocation > frame.fsize) && (beltLocation < 30))
-          {
-            return INVALID;
-          }
-         return frame.fast[(frame.ffront + beltLocation) & 0x1F];
-       }
-      else
-       {
-         if (((beltLocation & 0x1F) > frame.ssize) && (beltLocation < 62))
-          {
-            return INVALID;
-          }
-         return frame.slow[(frame.sfront + beltLocation) & 0x1F];
-       }
+      Record& record = ring[recorded++ & mask];
+      record.kind = kind;
+      record.a = static_cast<unsigned int>(a);
+      record.b = b;
     }
 
-   static bool extraNumerical(BELT_T op, BELT_T& res)
+   void cycle(size_t cycles, size_t alupc, size_t flowpc)
     {
-      if (0L != (op & (TRANSIENT | INVALID)))
-       {
-         res = op;
-         return true;
-       }
-      return false;
+      add(CYCLE, alupc, (static_cast<unsigned long long>(flowpc) << 32) | (cycles & 0xFFFFFFFFU));
     }
 
-   static bool extraNumerical(BELT_T op1, BELT_T op2, BELT_T& res)
+   // Out of line, so that retiring doesn't grow for it.
+   __attribute__((noinline)) void drops(const BELT_T* fast, size_t fcount, const BELT_T* slow, size_t scount)
     {
-      if (0L != ((op1 & op2) & TRANSIENT))
-       {
-         res = op1 > op2 ? op1 : op2; // Assume that the flow address of highest value is
-         return true; // the chronologically earlier instruction
-       }
-      if (0L != (op1 & TRANSIENT)) // TRANSIENT takes precedence over INVALID
-       {
-         res = op1;
-         return true;
-       }
-      if (0L != (op2 & TRANSIENT))
-       {
-         res = op2;
-         return true;
-       }
-      if (0L != ((op1 & op2) & INVALID))
+      for (size_t i = 0U; i < fcount; ++i)
        {
-         res = op1 > op2 ? op1 : op2;
-         return true;
-       }
-      if (0L != (op1 & INVALID)) // Save the metadata for INVALID
-       {
-         res = op1;
-         return true;
+         add(DROP_FAST, 0U, static_cast<unsigned long long>(fast[i]));
        }
-      if (0L != (op2 & INVALID))
+      for (size_t i = 0U; i < scount; ++i)
        {
-         res = op2;
-         return true;
+         add(DROP_SLOW, 0U, static_cast<unsigned long long>(slow[i]));
        }
-      return false;
     }
 
-   static bool extraNumerical(BELT_T op1, BELT_T op2, BELT_T op3, BELT_T& res)
+   // The header is the tag, then the number of records that follow, how many there have been, and
+   // the cycle count when it was written; the records follow, oldest first.
+   void write(const char * name, size_t cycles)
     {
-      BELT_T temp = TRANSIENT;
-      bool result = false;
-      if (0L != (op1 & TRANSIENT))
-       {
-         temp = temp > op1 ? temp : op1;
-         result = true;
-       }
-      if (0L != (op2 & TRANSIENT))
-       {
-         temp = temp > op2 ? temp : op2;
-         result = true;
-       }
-      if (0L != (op3 & TRANSIENT))
-       {
-         temp = temp > op3 ? temp : op3;
-         result = true;
-       }
-      if (true == result)
-       {
-         res = temp;
-         return true;
-       }
-      temp = INVALID;
-      if (0L != (op1 & INVALID))
+      requested = 0;
+      std::FILE * file = std::fopen(name, "wb");
+      if (NULL == file)
        {
-         temp = temp > op1 ? temp : op1;
-         result = true;
+         return;
        }
-      if (0L != (op2 & INVALID))
+      std::fprintf(file, "Mill%s%d Record  ", endian(), static_cast<int>(sizeof(size_t)));
+      const unsigned long long held = std::min(recorded, ring.size());
+      const unsigned long long header [3] = { held, recorded, cycles };
+      std::fwrite(static_cast<const void*>(header), sizeof(header[0]), 3U, file);
+      for (size_t i = recorded - static_cast<size_t>(held); i < recorded; ++i)
        {
-         temp = temp > op2 ? temp : op2;
-         result = true;
+         std::fwrite(static_cast<const void*>(&ring[i & mask]), sizeof(Record), 1U, file);
        }
-      if (0L != (op3 & INVALID))
+      std::fclose(file);
+    }
+ };
+
+volatile sig_atomic_t Recorder::requested = 0;
+
+#ifdef MILL_STATS
+// What the core counts, when built with MILL_STATS. In each cycle, each slot either runs an operation,
+// runs a NOP, or sits out a NOP that the other stream elided.
+enum SlotUse
+ {
+   SLOT_OP,
+   SLOT_NOP,
+   SLOT_ELIDED
+ };
+
+class Counters
+ {
+public:
+   size_t cycles; // Retired
+   size_t width; // ALU slots in use
+   size_t alu [MAX_ALUNITS][3]; // By SlotUse
+   size_t flow [FLOW_UNITS][3];
+   size_t transients; // Dropped on a belt
+   size_t invalids;
+   size_t calls;
+   size_t returns;
+   size_t depth; // The most frames there have been
+   size_t canons;
+   size_t interrupts;
+   size_t branches [2]; // Not taken, taken
+   size_t memory [2]; // Loads and stores issued: with a shorter belt, more of them are spills and fills
+   size_t lost; // Values pushed off the end of a full belt
+
+   Counters()
+    {
+      std::memset(static_cast<void*>(this), 0, sizeof(Counters));
+      width = DEFAULT_ALUNITS;
+      depth = 1U;
+    }
+
+   // All of the counters, in the order the gestalt interrupt numbers them.
+   void list(std::vector<std::string>& names, std::vector<size_t>& values) const
+    {
+      static const char * const uses [3] = { "ops", "nops", "elided" };
+      char name [32];
+      names.clear();
+      values.clear();
+      names.push_back("cycles"); values.push_back(cycles);
+      for (size_t i = 0U; i < width; ++i)
        {
-         temp = temp > op3 ? temp : op3;
-         result = true;
+         for (size_t j = 0U; j < 3U; ++j)
+          {
+            std::snprintf(name, sizeof(name), "alu%d_%s", static_cast<int>(i), uses[j]);
+            names.push_back(name); values.push_back(alu[i][j]);
+          }
        }
-      if (true == result)
+      for (size_t i = 0U; i < FLOW_UNITS; ++i)
        {
-         res = temp;
+         for (size_t j = 0U; j < 3U; ++j)
+          {
+            std::snprintf(name, sizeof(name), "flow%d_%s", static_cast<int>(i), uses[j]);
+            names.push_back(name); values.push_back(flow[i][j]);
+          }
        }
-      return result;
+      names.push_back("transient_drops"); values.push_back(transients);
+      names.push_back("invalid_drops"); values.push_back(invalids);
+      names.push_back("calls"); values.push_back(calls);
+      names.push_back("returns"); values.push_back(returns);
+      names.push_back("max_depth"); values.push_back(depth);
+      names.push_back("canons"); values.push_back(canons);
+      names.push_back("interrupts"); values.push_back(interrupts);
+      names.push_back("branches_taken"); values.push_back(branches[1]);
+      names.push_back("branches_not_taken"); values.push_back(branches[0]);
+      names.push_back("loads"); values.push_back(memory[0]);
+      names.push_back("stores"); values.push_back(memory[1]);
+      names.push_back("belt_losses"); values.push_back(lost);
     }
 
-   static BELT_T getZero(BELT_T input)
+   void print(std::FILE * file, bool json) const
     {
-      if (0U == (input & 0xFFFFFFFF))
+      std::vector<std::string> names;
+      std::vector<size_t> values;
+      list(names, values);
+      std::fprintf(file, json ? "{" : "Counters:\n");
+      for (size_t i = 0U; i < names.size(); ++i)
        {
-         return ZERO;
+         if (true == json)
+          {
+            std::fprintf(file, "%s\"%s\": %llu", (0U == i) ? "" : ", ", names[i].c_str(), static_cast<unsigned long long>(values[i]));
+          }
+         else
+          {
+            std::fprintf(file, "  %-20s %llu\n", names[i].c_str(), static_cast<unsigned long long>(values[i]));
+          }
        }
-      return 0;
+      std::fprintf(file, json ? "}\n" : "");
     }
+ };
+#endif
 
-   static BELT_T getAdd(BELT_T op1, BELT_T op2, BELT_T op3)
+// What a cycle drops onto a Frame's belts, in order. It all goes on at once: each belt's
+// front moves once.
+class Drops
+ {
+public:
+   static const size_t MOST = MAX_ALUNITS * ALU_RETIRE_SIZE + FLOW_UNITS * (FLOW_RETIRE_SIZE + BELT_SIZE);
+   BELT_T fast [MOST];
+   BELT_T slow [MOST];
+   size_t fcount;
+   size_t scount;
+   Recorder * recorder;
+#ifdef MILL_STATS
+   Counters * counters;
+
+   Drops() : fcount(0U), scount(0U), recorder(NULL), counters(NULL) { }
+
+   void count(BELT_T value)
     {
-      BELT_T cb = (op3 & CARRY) ? 1 : 0;
-      BELT_T result = (op1 + op2 + cb) & 0x1FFFFFFFFLL; // CARRY/BORROW is free
-      if (0U != ((result ^ op1) & (result ^ op2) & 0x80000000))
+      counters->transients += (0U != (value & TRANSIENT)) ? 1U : 0U;
+      counters->invalids += (0U != (value & INVALID)) ? 1U : 0U;
+    }
+
+   void dropFast(BELT_T value) { count(value); fast[fcount++] = value; }
+   void dropSlow(BELT_T value) { count(value); slow[scount++] = value; }
+#else
+   Drops() : fcount(0U), scount(0U), recorder(NULL) { }
+
+   void dropFast(BELT_T value) { fast[fcount++] = value; }
+   void dropSlow(BELT_T value) { slow[scount++] = value; }
+#endif
+
+   static void retire(Belt& belt, size_t& front, size_t& size, const BELT_T* values, size_t count)
+    {
+      front = (front - count) & BELT_MASK;
+      for (size_t i = 0U; i < count; ++i) // The last value dropped is at the front.
        {
-         result |= OVERFLOW;
+         belt.set((front + count - 1U - i) & BELT_MASK, values[i]);
        }
-      return result;
+      size = (size + count) < BELT_SIZE ? size + count : BELT_SIZE;
     }
 
-   bool conditionTrue(BELT_T cond, BELT_T flags)
+   // How many values dropping count onto a belt holding size pushes off its end.
+   static size_t lost(size_t size, size_t count)
     {
-      if (0U != (cond & ~0xFLL))
+      return (size + count > BELT_SIZE) ? size + count - BELT_SIZE : 0U;
+    }
+
+   // Put everything dropped so far onto frame's belts.
+   void retire(Frame& frame)
+    {
+      if (NULL != recorder)
        {
-         std::printf("Arrived in conditionTrue with invalid condition code.\nThis is a bug.\n");
-         machine->invalidOp = true;
-         return false;
+         recorder->drops(fast, fcount, slow, scount);
        }
-      static const BELT_T conds [] = { 0U, CARRY, OVERFLOW, NEGATIVE, ZERO, ZERO | NEGATIVE, INVALID, TRANSIENT };
-      if (0 == cond)
+#ifdef MILL_STATS
+      counters->lost += lost(frame.fsize, fcount) + lost(frame.ssize, scount);
+#endif
+      if (0U != fcount)
        {
-         return true;
+         retire(frame.fast, frame.ffront, frame.fsize, fast, fcount);
+         fcount = 0U;
        }
-      else if (1 == cond)
+      if (0U != scount)
        {
-         return (0U == (flags & (INVALID | TRANSIENT)));
+         retire(frame.slow, frame.sfront, frame.ssize, slow, scount);
+         scount = 0U;
        }
-      else
+    }
+ };
+
+static const unsigned char UNDECODED = 0xFF;
+
+// An ALU instruction word, with its fields pulled out.
+class ALUDecoded
+ {
+public:
+   unsigned char code; // The opcode (the low five bits), or UNDECODED
+   unsigned char slow; // Drops to the slow belt
+   unsigned char cond;
+   unsigned char nops; // Flow NOPs to elide
+   unsigned char src, a, b, c; // Belt positions, as they are used by the opcode
+   unsigned int imm; // Immediate, sign-extended to a word
+
+   ALUDecoded() : code(UNDECODED) { }
+   explicit ALUDecoded(MEM_T curOp) { decode(curOp); }
+
+   void decode(MEM_T curOp)
+    {
+      code = curOp & 0x1F;
+      slow = (0U != (curOp & 0x20)) ? 1U : 0U;
+      cond = 0U;
+      src = a = b = c = 0U;
+      imm = 0U;
+      if ((curOp & 0xF) > 5)
        {
-         if (0U == (cond & 1))
+         if (0U == (curOp & 0x10))
           {
-            return (0U != (flags & conds[cond >> 1]));
+            cond = (curOp >> 6) & 0xF;
+            src = (curOp >> 10) & 0x3F;
+            a = (curOp >> 16) & 0x3F;
+            b = (curOp >> 22) & 0x3F;
+            nops = (curOp >> 28) & 0x7;
           }
          else
           {
-            return (0U == (flags & conds[cond >> 1]));
+            a = (curOp >> 6) & 0x3F;
+            imm = (curOp >> 12) & 0x1FFFF;
+            if (imm & 0x10000)
+             {
+               imm |= 0xFFFE0000;
+             }
+            nops = (curOp >> 29) & 0x7;
           }
        }
+      else
+       {
+         cond = (curOp >> 6) & 0xF; // Only for PICK
+         a = (curOp >> 10) & 0x3F;
+         b = (curOp >> 16) & 0x3F;
+         c = (curOp >> 22) & 0x3F;
+         nops = (curOp >> 28) & 0x7;
+       }
     }
  };
 
-class ALUnit : public FunctionalUnit
+// A Flow instruction word, with its fields pulled out.
+class FlowDecoded
  {
 public:
-   virtual void doStuff()
+   unsigned char code; // The opcode (the low four bits), or UNDECODED
+   unsigned char slow; // Drops to the slow belt, or canonizes the slow belt
+   unsigned char cond;
+   unsigned char nops; // ALU NOPs to elide
+   unsigned char src, a, b; // Belt positions
+   unsigned char num; // Number of arguments (for the memory ops, this is also the belt position a)
+   unsigned char rets; // Number of returns of a CALL or INT
+   unsigned char service; // Service code of an INT
+   unsigned char next; // Number of ARGS words that follow
+   int imm; // Sign-extended displacement of a JMPI or CALLI
+
+   FlowDecoded() : code(UNDECODED) { }
+   explicit FlowDecoded(MEM_T curOp) { decode(curOp); }
+
+   void decode(MEM_T curOp)
     {
-      for (;;)
+      code = curOp & 0xF;
+      slow = (0U != (curOp & 0x10)) ? 1U : 0U;
+      cond = (curOp >> 5) & 0xF;
+      src = (curOp >> 9) & 0x3F;
+      num = (curOp >> 15) & 0x3F;
+      a = num;
+      b = (curOp >> 21) & 0x3F;
+      nops = (curOp >> 27) & 0x7;
+      rets = 0U;
+      service = 0U;
+      next = 0U;
+      imm = 0;
+      switch (code)
        {
-         //Wait for the start of an instruction cycle
-         pthread_barrier_wait(synchronizer);
-         // Do we need to die?
-         if (true == machine->terminate)
-          {
-//            std::printf("Terminating ALU slot: %lu\n", slot);
+         case 0: // NOP
+            nops = (curOp >> 29) & 0x7;
             break;
-          }
-         // Interpret and execute the next operation.
-         Frame& frame = machine->frames.back();
-         ALURetire& retire = frame.alu_retire[slot];
-         retire.flush(); // Make retire station is clean.
-         if (0U == frame.alunop)
-          {
-//            std::printf("Executing ALU slot: %lu %lu\n", slot, frame.alupc);
-            BELT_T curOp = getMemory(frame.alupc + slot);
-            if (0U != (curOp & INVALID))
-             {
-               std::printf("Terminate initiated due to invalid operation in ALU slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.alupc + slot));
-               machine->invalidOp = true;
-             }
-            if ((curOp & 0xF) > 5)
+         case 8: // CANON
+         case 9: // RET
+            next = num / 4 + ((0 != (num % 4)) ? 1 : 0);
+            break;
+         case 10: // JMPI
+            cond = (curOp >> 4) & 0xF;
+            src = (curOp >> 8) & 0x3F;
+            imm = (curOp >> 14) & 0x7FFF;
+            if (0 != (imm & 0x4000))
              {
-               BELT_T cond, src, op1, op2, temp;
-               BELT_T* dest;
-               if (0 == (curOp & 0x10))
-                {
-                  cond = (curOp >> 6) & 0xF;
-                  src = getBeltContent(frame, (curOp >> 10) & 0x3F);
-                  op1 = getBeltContent(frame, (curOp >> 16) & 0x3F);
-                  op2 = getBeltContent(frame, (curOp >> 22) & 0x3F);
-                  retire.nops = (curOp >> 28) & 0x7;
-                }
-               else
-                {
-                  cond = 0; // Unconditional
-                  src = 0;
-                  op1 = getBeltContent(frame, (curOp >> 6) & 0x3F);
-                  op2 = (curOp >> 12) & 0x1FFFF;
-                  if (op2 & 0x10000)
-                   {
-                     op2 |= 0xFFFE0000;
-                   }
-                  retire.nops = (curOp >> 29) & 0x7;
-                }
-               dest = retire.fast;
-               if (curOp & 0x20)
-                {
-                  dest = retire.slow;
-                }
-               if (false == conditionTrue(cond, src))
-                {
-                  dest[0] = TRANSIENT | frame.alupc;
-                  if ((9 == (curOp & 0xF)) || (10 == (curOp & 0xF)))
-                   {
-                     dest[1] = TRANSIENT | frame.alupc;
-                   }
-                }
-               else if (true == extraNumerical(op1, op2, temp))
-                {
-                  dest[0] = temp;
-                  if ((9 == (curOp & 0xF)) || (10 == (curOp & 0xF)))
-                   {
-                     dest[1] = temp;
-                   }
-                }
-               else
-                {
-                  switch (curOp & 0xF)
-                   {
-                     case 6: // ADD
-                        temp = getAdd(op1 & 0xFFFFFFFFLL, op2 & 0xFFFFFFFFLL, 0U);
-                        break;
-                     case 7: // SUB
-                        temp = getAdd(op1 & 0xFFFFFFFFLL, (op2 & 0xFFFFFFFFLL) ^ 0xFFFFFFFFLL, CARRY) ^ CARRY;
-                        break;
-                     case 8: // MUL
-                        temp = (op1 & 0xFFFFFFFFLL) * (op2 & 0xFFFFFFFFLL);
-                        if (0U != ((op1 ^ op2 ^ temp) & 0x80000000LL))
-                         {
-                           temp = (temp & 0xFFFFFFFFLL) | OVERFLOW;
-                         }
-                        else
-                         {
-                           temp &= 0xFFFFFFFFLL;
-                         }
-                        break;
-                     case 9: // DIV
-                        if (0U == (op2 & 0xFFFFFFFFLL))
-                         {
-                           temp = INVALID | frame.alupc;
-                           dest[1] = temp;
-                         }
-                        else
-                         {
-                           if (0U != (op1 & NEGATIVE))
-                            {
-                              op1 |= 0xFFFFFFFF00000000LL;
-                            }
-                           else
-                            {
-                              op1 &= 0xFFFFFFFFLL;
-                            }
-                           if (0U != (op2 & NEGATIVE))
-                            {
-                              op2 |= 0xFFFFFFFF00000000LL;
-                            }
-                           else
-                            {
-                              op2 &= 0xFFFFFFFFLL;
-                            }
-                           temp = (op1 / op2) & 0xFFFFFFFFLL;
-                           BELT_T temp2 = (op1 % op2) & 0xFFFFFFFFLL;
-                           temp2 |= getZero(temp2);
-                           dest[1] = temp2;
-                         }
-                        break;
-                     case 10: // UDIV
-                        if (0U == (op2 & 0xFFFFFFFFLL))
-                         {
-                           temp = INVALID | frame.alupc;
-                           dest[1] = temp;
-                         }
-                        else
-                         {
-                           temp = ((op1 & 0xFFFFFFFFLL) / (op2 & 0xFFFFFFFFLL)) & 0xFFFFFFFFLL;
-                           BELT_T temp2 = ((op1 & 0xFFFFFFFFLL) % (op2 & 0xFFFFFFFFLL)) & 0xFFFFFFFFLL;
-                           temp2 |= getZero(temp2);
-                           dest[1] = temp2;
-                         }
-                        break;
-                     case 11: // SHR
-                        if (0U == (op2 & NEGATIVE)) // op2 is positive, so shift is right
-                         {
-                           if (0 != (op2 & 0x7FFFFFFFLL))
-                            {
-                              if (33U <= (op2 & 0x7FFFFFFFLL))
-                               {
-                                 temp = 0U;
-                               }
-                              else
-                               {
-                                 temp = ((op1 & 0xFFFFFFFFLL) >> ((op2 & 0xFFFFFFFFLL) - 1)) & 0xFFFFFFFFLL;
-                                 BELT_T out = temp & 1;
-                                 temp >>= 1;
-                                 if (1 == out)
-                                  {
-                                    temp |= CARRY;
-                                  }
-                               }
-                            }
-                           else
-                            {
-                              temp = op1 & 0xFFFFFFFFLL;
-                            }
-                         }
-                        else
-                         {
-                           if (33U <= (-op2 & 0x7FFFFFFFLL))
-                            {
-                              temp = 0U;
-                            }
-                           else
-                            {
-                              temp = ((op1 & 0xFFFFFFFFLL) << (-op2 & 0xFFFFFFFFLL)) & 0x1FFFFFFFFLL;
-                            }
-                         }
-                        break;
-                     case 12: // ASHR
-                        if (0U == (op2 & NEGATIVE)) // op2 is positive, so shift is right
-                         {
-                           if (32U <= (op2 & 0x7FFFFFFFLL))
-                            {
-                              if (0U == (op1 & NEGATIVE))
-                               {
-                                 temp = 0U;
-                               }
-                              else
-                               {
-                                 temp = 0xFFFFFFFFLL;
-                               }
-                            }
-                           else
-                            {
-                              if (0U != (op1 & NEGATIVE))
-                               {
-                                 op1 |= 0xFFFFFFFF00000000LL;
-                               }
-                              else
-                               {
-                                 op1 &= 0xFFFFFFFFLL;
-                               }
-                              temp = (op1 >> (op2 & 0xFFFFFFFFLL)) & 0xFFFFFFFFLL;
-                            }
-                         }
-                        else // Standard shift left.
-                         {
-                           if (32U <= (-op2 & 0x7FFFFFFFLL))
-                            {
-                              temp = 0U;
-                            }
-                           else
-                            {
-                              temp = ((op1 & 0xFFFFFFFFLL) << (-op2 & 0xFFFFFFFFLL)) & 0xFFFFFFFFLL;
-                            }
-                         }
-                        break;
-                     case 13: // AND
-                        temp = (op1 & op2) & 0xFFFFFFFFLL;
-                        break;
-                     case 14: // OR
-                        temp = (op1 | op2) & 0xFFFFFFFFLL;
-                        break;
-                     case 15: // XOR
-                        temp = (op1 ^ op2) & 0xFFFFFFFFLL;
-                        break;
-                   }
-                  temp |= getZero(temp);
-                  dest[0] = temp;
-                }
+               imm |= ~0x7FFF;
              }
-            else
+            nops = (curOp >> 29) & 0x7;
+            break;
+         case 11: // CALLI
+            num = (curOp >> 4) & 0x1F;
+            next = num / 4 + ((0 != (num % 4)) ? 1 : 0);
+            imm = (curOp >> 9) & 0xFFFFF;
+            if (0 != (imm & 0x80000))
              {
-               BELT_T* dest = retire.fast;
-               if (curOp & 0x20)
-                {
-                  dest = retire.slow;
-                }
-               BELT_T op1 = getBeltContent(frame, (curOp >> 10) & 0x3F);
-               BELT_T op2 = getBeltContent(frame, (curOp >> 16) & 0x3F);
-               BELT_T op3 = getBeltContent(frame, (curOp >> 22) & 0x3F);
-               BELT_T temp;
-               retire.nops = (curOp >> 28) & 0x7;
-               switch (curOp & 0x1F)
-                {
-                  case 0: // NOP
-                     break;
-                  case 1: // ADDC
-                     if (false == extraNumerical(op1, op2, temp))
-                      {
-                        temp = getAdd(op1 & 0xFFFFFFFFLL, op2 & 0xFFFFFFFFLL, op3);
-                        temp |= getZero(temp);
-                      }
-                     dest[0] = temp;
-                     break;
-                  case 2: // SUBB
-                     if (false == extraNumerical(op1, op2, temp))
-                      {
-                        temp = getAdd(op1 & 0xFFFFFFFFLL, (op2 & 0xFFFFFFFFLL) ^ 0xFFFFFFFFLL, op3 ^ CARRY) ^ CARRY;
-                        temp |= getZero(temp);
-                      }
-                     dest[0] = temp;
-                     break;
-                  case 3: // MULL
-                     if (true == extraNumerical(op1, op2, temp))
-                      {
-                        dest[0] = temp;
-                        dest[1] = temp;
-                      }
-                     else
-                      {
-                        temp = (op1 & 0xFFFFFFFFLL) * (op2 & 0xFFFFFFFFLL);
-                        BELT_T temp1 = temp & 0xFFFFFFFFLL;
-                        BELT_T temp2 = (temp >> 32) & 0xFFFFFFFFLL;
-                        temp1 |= getZero(temp1);
-                        temp2 |= getZero(temp2);
-                        dest[0] = temp1;
-                        dest[1] = temp2;
-                      }
-                     break;
-                  case 4: // DIVL
-                     if (true == extraNumerical(op1, op2, op3, temp))
-                      {
-                        dest[0] = temp;
-                        dest[1] = temp;
-                      }
-                     else
-                      {
-                        if (0U == (op3 & 0xFFFFFFFFLL))
-                         {
-                           temp = INVALID | frame.alupc;
-                           dest[0] = temp;
-                           dest[1] = temp;
-                         }
-                        else
-                         {
-                           temp = static_cast<unsigned long long>((op1 << 32) | (op2 & 0xFFFFFFFFLL)) / (op3 & 0xFFFFFFFFLL);
-                           BELT_T temp2 = static_cast<unsigned long long>((op1 << 32) | (op2 & 0xFFFFFFFFLL)) % (op3 & 0xFFFFFFFFLL);
-                           if (temp > 0xFFFFFFFFLL)
-                            {
-                              temp = (temp & 0xFFFFFFFFLL) | OVERFLOW;
-                            }
-                           temp |= getZero(temp);
-                           temp2 |= getZero(temp2);
-                           dest[0] = temp;
-                           dest[1] = temp2;
-                         }
-                      }
-                     break;
-                  case 5: // PICK?
-                     if (conditionTrue((curOp >> 6) & 0xF, op1))
-                      {
-                        dest[0] = op2;
-                      }
-                     else
-                      {
-                        dest[0] = op3;
-                      }
-                     break;
-                  case 16: // RAISE INVALID OPERATION
-                  case 17: // RAISE INVALID OPERATION
-                  case 18: // RAISE INVALID OPERATION
-                  case 19: // RAISE INVALID OPERATION
-                  case 20: // RAISE INVALID OPERATION
-                  case 21: // RAISE INVALID OPERATION
-                     std::printf("Terminate initiated due to invalid operation in ALU slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.alupc + slot));
-                     machine->invalidOp = true;
-                     break;
-                }
+               imm |= ~0xFFFFF;
              }
-          }
-
-         // Signal that we have ended this cycle.
-         pthread_barrier_wait(synchronizer);
+            nops = (curOp >> 29) & 0x7;
+            break;
+         case 12: // CALL
+         case 13: // INT
+            cond = (curOp >> 4) & 0xF;
+            src = (curOp >> 8) & 0x3F;
+            a = (curOp >> 14) & 0x3F;
+            service = a;
+            num = (curOp >> 20) & 0x1F;
+            rets = (curOp >> 25) & 0x1F;
+            next = num / 4 + ((0 != (num % 4)) ? 1 : 0);
+            nops = (curOp >> 30) & 0x3;
+            break;
+         case 14: // RAISE INVALID OPERATION
+         case 15: // RAISE INVALID OPERATION
+            nops = 0U;
+            break;
        }
     }
  };
 
-class FlowUnit : public FunctionalUnit
+// The codec for packed Core images. Data is cut into chunks of PACK_CHUNK bytes, each packed on its own:
+//    raw_size:32 packed_size:32 {byte}
+// A chunk that doesn't get smaller is stored as it is, with packed_size == raw_size. Packed, it is a
+// series of tokens: 0 to 0x7F is a run of that many plus one literal bytes, which follow; 0x80 to 0xFF
+// is a match of (token & 0x7F) + MIN_MATCH bytes (if that is 0x7F, the bytes that follow are added on,
+// up to and including the first that isn't 255), and then a 16 bit distance back into what has been
+// unpacked. A match may overlap itself, which is what makes runs cheap.
+static const size_t PACK_CHUNK = 65536U;
+
+class Packer
  {
 public:
+   static const size_t MIN_MATCH = 4U;
+   static const size_t MAX_DISTANCE = 65535U;
+   static const size_t HASH_BITS = 14U;
 
-   void fillBelt(Frame& frame, int num)
+   // Pack size bytes into out, which has room for size bytes. Returns the packed size, or size if it
+   // didn't pay (when out holds junk).
+   static size_t pack(const unsigned char * in, size_t size, unsigned char * out)
     {
-      int memOff = -1; // Start at the current instruction
-      BELT_T cur = 0U; // If cur is used uninitialized, that is a bug in the compiler.
-      FlowRetire& retire = frame.flow_retire[slot];
-      for (int i = 0; i < num; ++i)
+      unsigned int head [1U << HASH_BITS]; // Where each hash was last seen, plus one
+      std::fill(head, head + (1U << HASH_BITS), 0U);
+      size_t o = 0U;
+      size_t lit = 0U;
+      size_t i = 0U;
+      while (i + MIN_MATCH <= size)
        {
-         if (0 == (i % 4)) // memOff is intentionally initialized for this to occur at zero
+         unsigned int word;
+         std::memcpy(static_cast<void*>(&word), static_cast<const void*>(in + i), sizeof(word));
+         const size_t hash = (word * 2654435761U) >> (32U - HASH_BITS);
+         const size_t seen = head[hash];
+         head[hash] = static_cast<unsigned int>(i + 1U);
+         if ((0U == seen) || (i + 1U - seen > MAX_DISTANCE) || (0 != std::memcmp(in + seen - 1U, in + i, MIN_MATCH)))
           {
-            --memOff;
-            cur = getMemory(frame.flowpc - slot + memOff);
-            if (0U != (cur & INVALID))
-             {
-               machine->invalidOp = true;
-             }
-            if (0x10 != (cur & 0x1F)) // Make sure this is an ARGS NOP
+            ++i;
+            continue;
+          }
+         const size_t from = seen - 1U;
+         size_t length = MIN_MATCH;
+         while ((i + length < size) && (in[from + length] == in[i + length]))
+          {
+            ++length;
+          }
+         if ((false == literals(in + lit, i - lit, out, o, size)) || (o + 4U + length / 255U > size))
+          {
+            return size;
+          }
+         size_t extra = length - MIN_MATCH;
+         if (extra < 0x7FU)
+          {
+            out[o++] = static_cast<unsigned char>(0x80U | extra);
+          }
+         else
+          {
+            out[o++] = 0xFFU;
+            for (extra -= 0x7FU; extra >= 255U; extra -= 255U)
              {
-               machine->invalidOp = true;
+               out[o++] = 255U;
              }
+            out[o++] = static_cast<unsigned char>(extra);
           }
-         retire.belt[i] = getBeltContent(frame, (cur >> (5 + 6 * (i % 4))) & 0x3F);
+         const size_t distance = i - from;
+         out[o++] = static_cast<unsigned char>(distance & 0xFFU);
+         out[o++] = static_cast<unsigned char>(distance >> 8);
+         i += length;
+         lit = i;
+       }
+      if (false == literals(in + lit, size - lit, out, o, size))
+       {
+         return size;
        }
+      return o;
     }
 
-   static void serviceInterrupt(Machine& machine, int /*serviceCode*/, const BELT_T* args, BELT_T* rets)
+   static bool literals(const unsigned char * in, size_t count, unsigned char * out, size_t& o, size_t size)
     {
-      switch (args[0] & 0xFFFFFFFFLL)
+      while (count > 0U)
        {
-         case 1: // request put character, TODO deprecate
-            putchar(args[1]);
-            break;
-         case 2: // request get character, TODO deprecate
-            rets[0] = getchar() & 0xFFFFFFFFLL;
-            rets[0] |= getZero(rets[0]);
-            break;
-         case 3: // request stop
-            machine.stop = true;
-            break;
-         case 4: // gestalt : currently return zero
-            rets[0] = ZERO;
-            break;
-         default: // INVALID OPERATION
-            std::printf("Terminate initiated due to invalid interrupt: %lld\n", args[0]);
-            machine.invalidOp = true;
-            break;
+         const size_t run = std::min(count, static_cast<size_t>(0x80U));
+         if (o + 1U + run > size)
+          {
+            return false;
+          }
+         out[o++] = static_cast<unsigned char>(run - 1U);
+         std::memcpy(static_cast<void*>(out + o), static_cast<const void*>(in), run);
+         o += run;
+         in += run;
+         count -= run;
        }
+      return true;
     }
 
-   virtual void doStuff()
+   // Returns false unless in unpacks into exactly raw bytes.
+   static bool unpack(const unsigned char * in, size_t size, unsigned char * out, size_t raw)
     {
-      for (;;)
+      if (size == raw)
        {
-         // Wait for the start of the instruction cycle
-         pthread_barrier_wait(synchronizer);
-         // Do we need to die?
-         if (true == machine->terminate)
-          {
-//            std::printf("Terminating Flow slot: %lu\n", slot);
-            break;
-          }
-         // Interpret and execute the next operation.
-         Frame& frame = machine->frames.back();
-         FlowRetire& retire = frame.flow_retire[slot];
-         retire.flush(); // Make retire station is clean.
-         if (0U == frame.flownop)
+         std::memcpy(static_cast<void*>(out), static_cast<const void*>(in), raw);
+         return true;
+       }
+      size_t p = 0U;
+      size_t o = 0U;
+      while (p < size)
+       {
+         const size_t token = in[p++];
+         if (token < 0x80U)
           {
-//            std::printf("Executing Flow slot: %lu %lu\n", slot, frame.flowpc);
-            BELT_T curOp = getMemory(frame.flowpc - slot - 1U);
-            if (0U != (curOp & INVALID))
-             {
-               std::printf("Terminate initiated due to invalid operation in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-               machine->invalidOp = true;
-             }
-            BELT_T cond, src, num, op1, op2, temp;
-            BELT_T* dest;
-            cond = (curOp >> 5) & 0xF;
-            src = getBeltContent(frame, (curOp >> 9) & 0x3F);
-            num = (curOp >> 15) & 0x3F;
-            op1 = getBeltContent(frame, num);
-            op2 = getBeltContent(frame, (curOp >> 21) & 0x3F);
-            dest = retire.fast;
-            if (curOp & 0x10)
+            const size_t run = token + 1U;
+            if ((p + run > size) || (o + run > raw))
              {
-               dest = &retire.slow;
+               return false;
              }
-            switch (curOp & 0xF)
+            std::memcpy(static_cast<void*>(out + o), static_cast<const void*>(in + p), run);
+            p += run;
+            o += run;
+            continue;
+          }
+         size_t length = (token & 0x7FU) + MIN_MATCH;
+         if (0x7FU == (token & 0x7FU))
+          {
+            size_t more;
+            do
              {
-               case 0: // NOP
-                  retire.nops = (curOp >> 29) & 0x7;
-                  break;
-               case 1: // JMP
-                  if ((0U != (op1 & TRANSIENT)) && conditionTrue(cond, src))
-                   {
-                     if (0U == (op1 & INVALID))
-                      {
-                        retire.jump = ((op1 & 0xFFFFFFFFLL) + frame.entryPoint) & 0xFFFFFFFFLL;
-                        if (0U == retire.jump)
-                         {
-                           std::printf("Terminate initiated due to branch to zero in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                           machine->invalidOp = true;
-                         }
-                      }
-                     else
-                      {
-                        std::printf("Terminate initiated due to branch to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                        machine->invalidOp = true;
-                      }
-                   }
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 2: // LD
-                  if (conditionTrue(cond, src))
-                   {
-                     if (false == extraNumerical(op1, temp))
-                      {
-                        temp = getMemory(op1 & 0xFFFFFFFFLL);
-                        if (0U == (temp & INVALID))
-                         {
-                           temp |= getZero(temp);
-                         }
-                        else
-                         {
-                           temp |= frame.flowpc;
-                         }
-                      }
-                     dest[0] = temp;
-                   }
-                  else
-                   {
-                     dest[0] = TRANSIENT | frame.flowpc;
-                   }
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 3: // LDH
-                  if (conditionTrue(cond, src))
-                   {
-                     if (false == extraNumerical(op1, temp))
-                      {
-                        temp = getMemory((op1 & 0xFFFFFFFFLL) >> 1);
-                        if (0U == (temp & INVALID))
-                         {
-                           temp >>= 16 * (op1 & 1);
-                           if (0U != (temp & 0x8000))
-                            {
-                              temp |= 0xFFFF0000LL;
-                            }
-                           else
-                            {
-                              temp &= 0xFFFF;
-                            }
-                           temp |= getZero(temp);
-                         }
-                        else
-                         {
-                           temp |= frame.flowpc;
-                         }
-                      }
-                     dest[0] = temp;
-                   }
-                  else
-                   {
-                     dest[0] = TRANSIENT | frame.flowpc;
-                   }
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 4: // LDB
-                  if (conditionTrue(cond, src))
-                   {
-                     if (false == extraNumerical(op1, temp))
-                      {
-                        temp = getMemory((op1 & 0xFFFFFFFFLL) >> 2);
-                        if (0U == (temp & INVALID))
-                         {
-                           temp >>= 8 * (op1 & 3);
-                           if (0U != (temp & 0x80))
-                            {
-                              temp |= 0xFFFFFF00LL;
-                            }
-                           else
-                            {
-                              temp &= 0xFF;
-                            }
-                           temp |= getZero(temp);
-                         }
-                        else
-                         {
-                           temp |= frame.flowpc;
-                         }
-                      }
-                     dest[0] = temp;
-                   }
-                  else
-                   {
-                     dest[0] = TRANSIENT | frame.flowpc;
-                   }
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 5: // ST
-                  if ((0U == ((op1 | op2) & TRANSIENT)) && conditionTrue(cond, src))
-                   {
-                     if (0U == ((op1 | op2) & INVALID))
-                      {
-                        if (INVALID == setMemory(op1 & 0xFFFFFFFFLL, op2 & 0xFFFFFFFFLL))
-                         {
-                           std::printf("Terminate initiated due to store to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                           machine->invalidOp = true;
-                         }
-                      }
-                     else
-                      {
-                        std::printf("Terminate initiated due to store of invalid in Flow slot: %d %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U), static_cast<int>(op2));
-                        machine->invalidOp = true;
-                      }
-                   }
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 6: // STH
-                  if ((0U == ((op1 | op2) & TRANSIENT)) && conditionTrue(cond, src))
-                   {
-                     if (0U == ((op1 | op2) & INVALID))
-                      {
-                        temp = getMemory((op1 & 0xFFFFFFFFLL) >> 1);
-                        if (INVALID != temp)
-                         {
-                           temp &= ~(0xFFFF << (16 * (op1 & 1)));
-                           temp |= ((op2 & 0xFFFF) << (16 * (op1 & 1)));
-                           setMemory((op1 & 0xFFFFFFFFLL) >> 1, temp);
-                         }
-                        else
-                         {
-                           std::printf("Terminate initiated due to store to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                           machine->invalidOp = true;
-                         }
-                      }
-                     else
-                      {
-                        std::printf("Terminate initiated due to store of invalid in Flow slot: %d %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U), static_cast<int>(op2));
-                        machine->invalidOp = true;
-                      }
-                   }
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 7: // STB
-                  if ((0U == ((op1 | op2) & TRANSIENT)) && conditionTrue(cond, src))
-                   {
-                     if (0U == ((op1 | op2) & INVALID))
-                      {
-                        temp = getMemory((op1 & 0xFFFFFFFFLL) >> 2);
-                        if (INVALID != temp)
-                         {
-                           temp &= ~(0xFF << (8 * (op1 & 3)));
-                           temp |= ((op2 & 0xFF) << (8 * (op1 & 3)));
-                           setMemory((op1 & 0xFFFFFFFFLL) >> 2, temp);
-                         }
-                        else
-                         {
-                           std::printf("Terminate initiated due to store to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                           machine->invalidOp = true;
-                         }
-                      }
-                     else
-                      {
-                        std::printf("Terminate initiated due to store of invalid in Flow slot: %d %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U), static_cast<int>(op2));
-                        machine->invalidOp = true;
-                      }
-                   }
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 8: // CANON
-                  if (conditionTrue(cond, src))
-                   {
-                     retire.use = (0 == (curOp & 0x10)) ? CANON : SLOW_CANON;
-                     fillBelt(frame, num);
-                   }
-                  retire.next = num / 4 + ((0 != (num % 4)) ? 1 : 0);
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 9: // RET
-                  if (conditionTrue(cond, src))
-                   {
-                     retire.use = SIGNAL_RETURN;
-                     fillBelt(frame, num);
-                   }
-                  retire.next = num / 4 + ((0 != (num % 4)) ? 1 : 0);
-                  retire.nops = (curOp >> 27) & 0x7;
-                  break;
-               case 10: // JMPI
-                  cond = (curOp >> 4) & 0xF;
-                  src = getBeltContent(frame, (curOp >> 8) & 0x3F);
-                  if (conditionTrue(cond, src))
-                   {
-                     temp = (curOp >> 14) & 0x7FFF;
-                     if (0U != (temp & 0x4000))
-                      {
-                        temp |= 0xFFFFFFFFFFFF8000LL;
-                      }
-                     retire.jump = frame.entryPoint + temp;
-                     if (0U == retire.jump)
-                      {
-                        std::printf("Terminate initiated due to branch to zero in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                        machine->invalidOp = true;
-                      }
-                   }
-                  retire.nops = (curOp >> 29) & 0x7;
-                  break;
-               case 11: // CALLI
-                  num = (curOp >> 4) & 0x1F;
-                  retire.next = num / 4 + ((0 != (num % 4)) ? 1 : 0);
-                  temp = (curOp >> 9) & 0xFFFFF;
-                  if (0U != (temp & 0x80000))
-                   {
-                     temp |= 0xFFFFFFFFFFF00000LL;
-                   }
-                  retire.jump = frame.entryPoint + temp;
-                  if (0U == retire.jump)
-                   {
-                     std::printf("Terminate initiated due to branch to zero in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                     machine->invalidOp = true;
-                   }
-                  retire.use = SIGNAL_CALL;
-                  fillBelt(frame, num);
-                  retire.nops = (curOp >> 29) & 0x7;
-                  break;
-               case 12: // CALL
-                  cond = (curOp >> 4) & 0xF;
-                  src = getBeltContent(frame, (curOp >> 8) & 0x3F);
-                  op1 = getBeltContent(frame, (curOp >> 14) & 0x3F);
-                  num = (curOp >> 20) & 0x1F;
-                  op2 = (curOp >> 25) & 0x1F;
-                  retire.nops = (curOp >> 30) & 0x3;
-                  retire.next = num / 4 + ((0 != (num % 4)) ? 1 : 0);
-                  if ((0U == (op1 & TRANSIENT)) && conditionTrue(cond, src))
-                   {
-                     if (0U == (op1 & INVALID))
-                      {
-                        retire.jump = ((op1 & 0xFFFFFFFFLL) + frame.entryPoint) & 0xFFFFFFFFLL;
-                        if (0U == retire.jump)
-                         {
-                           std::printf("Terminate initiated due to branch to zero in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                           machine->invalidOp = true;
-                         }
-                        retire.use = SIGNAL_CALL;
-                        fillBelt(frame, num);
-                      }
-                     else
-                      {
-                        std::printf("Terminate initiated due to branch to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                        machine->invalidOp = true;
-                      }
-                   }
-                  else
-                   {
-                     if (0U == (op1 & TRANSIENT))
-                      {
-                        op1 = TRANSIENT | frame.flowpc;
-                      }
-                     for (int i = 0; i < op2; ++i)
-                      {
-                        retire.fast[i] = op1; // ensure TRANSIENT
-                      }
-                   }
-                  break;
-               case 13: // INT
-                  cond = (curOp >> 4) & 0xF;
-                  src = getBeltContent(frame, (curOp >> 8) & 0x3F);
-                  op1 = (curOp >> 14) & 0x3F;
-                  num = (curOp >> 20) & 0x1F;
-                  op2 = (curOp >> 25) & 0x1F;
-                  retire.nops = (curOp >> 30) & 0x3;
-                  retire.next = num / 4 + ((0 != (num % 4)) ? 1 : 0);
-                  if (conditionTrue(cond, src))
-                   {
-                     fillBelt(frame, num);
-                     serviceInterrupt(*machine, op1, retire.belt, retire.fast);
-                   }
-                  else
-                   {
-                     for (int i = 0; i < op2; ++i)
-                      {
-                        retire.fast[i] = TRANSIENT | frame.flowpc;
-                      }
-                   }
-                  break;
-               case 14: // RAISE INVALID OPERATION
-               case 15: // RAISE INVALID OPERATION
-                  std::printf("Terminate initiated due to invalid operation in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
-                  machine->invalidOp = true;
-                  break;
+               if (p >= size)
+                {
+                  return false;
+                }
+               more = in[p++];
+               length += more;
              }
+            while (255U == more);
+          }
+         if (p + 2U > size)
+          {
+            return false;
+          }
+         const size_t distance = in[p] | (static_cast<size_t>(in[p + 1U]) << 8);
+         p += 2U;
+         if ((0U == distance) || (distance > o) || (o + length > raw))
+          {
+            return false;
+          }
+         for (const unsigned char * from = out + o - distance; length > 0U; --length)
+          {
+            out[o++] = *from++;
           }
-
-         // Signal that we have ended this cycle.
-         pthread_barrier_wait(synchronizer);
        }
+      return o == raw;
     }
- };
-
-class MillCore
- {
-public:
-   Machine* machine;
 
-   static void * runMe(void * slot)
+   // Write size bytes as chunks: one fwrite a chunk.
+   static void write(std::FILE * file, const void * data, size_t size)
     {
-      MillCore* unit = reinterpret_cast<MillCore*>(slot);
-      unit->doStuff();
-      return NULL;
+      const unsigned char * in = static_cast<const unsigned char*>(data);
+      std::vector<unsigned char> out (8U + PACK_CHUNK);
+      for (size_t at = 0U; at < size; at += PACK_CHUNK)
+       {
+         const unsigned int raw = static_cast<unsigned int>(std::min(PACK_CHUNK, size - at));
+         const unsigned int packed = static_cast<unsigned int>(pack(in + at, raw, &out[8U]));
+         if (packed == raw)
+          {
+            std::memcpy(static_cast<void*>(&out[8U]), static_cast<const void*>(in + at), raw);
+          }
+         std::memcpy(static_cast<void*>(&out[0U]), static_cast<const void*>(&raw), 4U);
+         std::memcpy(static_cast<void*>(&out[4U]), static_cast<const void*>(&packed), 4U);
+         std::fwrite(static_cast<void*>(&out[0U]), 1U, 8U + packed, file);
+       }
     }
 
-   static void * runOne(void * slot)
+   // Read a chunk's header, checking that it holds raw bytes. Returns its packed size, or 0 if it's bad.
+   static size_t header(std::FILE * file, size_t raw)
     {
-      FunctionalUnit* unit = reinterpret_cast<FunctionalUnit*>(slot);
-      unit->doStuff();
-      return NULL;
+      unsigned int sizes [2U] = { 0U, 0U };
+      if ((2U != std::fread(static_cast<void*>(sizes), sizeof(unsigned int), 2U, file)) || (raw != sizes[0]) || (sizes[1] > raw))
+       {
+         return 0U;
+       }
+      return sizes[1];
     }
 
-   void retire(Frame& frame, BELT_T value)
+   // The most that chunks in so many bytes of a file could unpack to: each has a header, and at least a byte.
+   static size_t reach(size_t bytes)
     {
-      frame.ffront = (frame.ffront - 1) & 0x1F;
-      frame.fast[frame.ffront] = value;
-      frame.fsize = frame.fsize < BELT_SIZE ? frame.fsize + 1 : BELT_SIZE;
-
-      frame.fast[(frame.ffront + 30) & 0x1F] = ZERO;
-      frame.fast[(frame.ffront + 31) & 0x1F] = 1;
+      return bytes / (2U * sizeof(unsigned int) + 1U) * PACK_CHUNK;
     }
 
-   void slowretire(Frame& frame, BELT_T value)
+   // Read what write wrote. Returns false if it is damaged.
+   static bool read(std::FILE * file, void * data, size_t size)
     {
-      frame.sfront = (frame.sfront - 1) & 0x1F;
-      frame.slow[frame.sfront] = value;
-      frame.ssize = frame.ssize < BELT_SIZE ? frame.ssize + 1 : BELT_SIZE;
-
-      frame.slow[(frame.sfront + 30) & 0x1F] = INVALID;
-      frame.slow[(frame.sfront + 31) & 0x1F] = TRANSIENT;
+      unsigned char * out = static_cast<unsigned char*>(data);
+      std::vector<unsigned char> in (PACK_CHUNK);
+      for (size_t at = 0U; at < size; at += PACK_CHUNK)
+       {
+         const size_t raw = std::min(PACK_CHUNK, size - at);
+         const size_t packed = header(file, raw);
+         if ((0U == packed) || (packed != std::fread(static_cast<void*>(&in[0U]), 1U, packed, file)) ||
+             (false == unpack(&in[0U], packed, out + at, raw)))
+          {
+            return false;
+          }
+       }
+      return true;
     }
+ };
 
-   void doStuff()
-    {
-      pthread_barrier_t synchronizer;
-      pthread_barrier_init(&synchronizer, NULL, ALUNITS + FLOW_UNITS + 1U);
-      ALUnit aunits [ALUNITS];
-      FlowUnit funits [FLOW_UNITS];
+#ifdef __linux__
+#define MILL_LAZY_CORE
+#endif
 
-      for (size_t i = 0U; i < ALUNITS; ++i)
+#ifdef MILL_LAZY_CORE
+// The memory of a packed Core, unpacked a chunk at a time as it is first touched, so that the core
+// can start before the whole image is unpacked. Memory starts out PROT_NONE. The SIGSEGV handler
+// unpacks the chunk into fresh pages and mremaps them into place in one step, so that a unit on
+// another thread never sees half of a chunk.
+class LazyMemory
+ {
+public:
+   static const size_t SLOTS = 16U; // Machines with lazy memory at one time
+
+   char * base;
+   size_t bytes;
+   const unsigned char * image; // The file, mapped
+   size_t imageSize;
+   std::vector<size_t> chunks; // Where each chunk's header is in the image
+   std::atomic<unsigned char> * state; // Of each chunk: 0 packed, 1 unpacking, 2 done, 3 damaged (and zeroed), 4 unmapped
+   bool * invalidOp; // The Machine's, raised when a chunk turns out to be damaged
+   std::atomic<bool> damaged; // Until the engine has reported it
+   size_t page; // Read here, as fault() can't call sysconf
+
+   static std::atomic<LazyMemory*> active [SLOTS];
+   static struct sigaction previous; // Whoever had SIGSEGV before, for the faults that aren't ours
+
+   LazyMemory() : base(NULL), bytes(0U), image(NULL), imageSize(0U), state(NULL), invalidOp(NULL), damaged(false), page(0U) { }
+
+   ~LazyMemory()
+    {
+      for (size_t i = 0U; i < SLOTS; ++i)
        {
-         aunits[i].machine = machine;
-         aunits[i].synchronizer = &synchronizer;
-         aunits[i].slot = i;
-         pthread_create(&aunits[i].thread, NULL, runOne, reinterpret_cast<void*>(&aunits[i]));
+         LazyMemory* self = this;
+         active[i].compare_exchange_strong(self, NULL);
        }
-
-      for (size_t i = 0U; i < FLOW_UNITS; ++i)
+      if (NULL != image)
        {
-         funits[i].machine = machine;
-         funits[i].synchronizer = &synchronizer;
-         funits[i].slot = i;
-         pthread_create(&funits[i].thread, NULL, runOne, reinterpret_cast<void*>(&funits[i]));
+         munmap(const_cast<void*>(static_cast<const void*>(image)), imageSize);
        }
+      delete [] state;
+    }
 
-      for (;;)
+   // With the file at the first chunk of memory. Returns NULL (with the file where it was) if memory
+   // can't be made lazy, or a chunk header is bad.
+   static LazyMemory* open(std::FILE * file, MEM_T * memory, size_t size, bool& invalidOp)
+    {
+      const long start = std::ftell(file);
+      LazyMemory* lazy = new LazyMemory();
+      lazy->invalidOp = &invalidOp;
+      lazy->base = static_cast<char*>(static_cast<void*>(memory));
+      lazy->bytes = size * sizeof(MEM_T);
+      lazy->page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      struct stat info;
+      lazy->imageSize = (0 == fstat(fileno(file), &info)) ? static_cast<size_t>(info.st_size) : 0U;
+      for (size_t at = 0U; at < lazy->bytes; at += PACK_CHUNK)
        {
-         // Signal the start of the instruction cycle
-         pthread_barrier_wait(&synchronizer);
-         // Wait for the end of this cycle.
-         pthread_barrier_wait(&synchronizer);
-
-         // Synthesize unit data.
-//         std::printf("Instruction finished\n");
-         Frame* frame = &machine->frames.back();
-//  Dec NOP counters OR move PCs
-//    IF we performed an instruction, move the PC while we have the data to do so.
-         if (0U != frame->alunop)
-          {
-            --frame->alunop;
-          }
-         else
-          {
-            frame->alupc += ALUNITS;
-          }
-         if (0U != frame->flownop)
+         lazy->chunks.push_back(static_cast<size_t>(std::ftell(file)));
+         const size_t packed = Packer::header(file, std::min(PACK_CHUNK, lazy->bytes - at));
+         if ((0U == packed) || (lazy->chunks.back() + 8U + packed > lazy->imageSize) ||
+             (0 != std::fseek(file, static_cast<long>(packed), SEEK_CUR)))
           {
-            --frame->flownop;
-          }
-         else
-          {
-            //  Accumulate flow delta
-            size_t addPC = 0U;
-            for (size_t i = 0U; i < FLOW_UNITS; ++i)
-             {
-               addPC += frame->flow_retire[i].next;
-             }
-            frame->flowpc -= (FLOW_UNITS + addPC);
+            std::fseek(file, start, SEEK_SET);
+            delete lazy;
+            return NULL;
           }
-//  Accumulate NOPs and add to counters
-         size_t addNops = 0U;
-         for (size_t i = 0U; i < FLOW_UNITS; ++i)
+       }
+      void * map = mmap(NULL, lazy->imageSize, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+      lazy->state = new std::atomic<unsigned char> [lazy->chunks.size()]();
+      size_t slot = 0U;
+      for (LazyMemory* empty = NULL; (slot < SLOTS) && (false == active[slot].compare_exchange_strong(empty, lazy)); ++slot)
+       {
+         empty = NULL;
+       }
+      if ((0U == lazy->bytes) || (MAP_FAILED == map) || (SLOTS == slot) ||
+          (0 != mprotect(static_cast<void*>(lazy->base), lazy->bytes, PROT_NONE)))
+       {
+         lazy->image = (MAP_FAILED == map) ? NULL : static_cast<const unsigned char*>(map);
+         std::fseek(file, start, SEEK_SET);
+         delete lazy;
+         return NULL;
+       }
+      lazy->image = static_cast<const unsigned char*>(map);
+      static const bool installed = install(); // Once, by whichever -batch worker gets here first
+      (void) installed;
+      return lazy;
+    }
+
+   static bool install()
+    {
+      struct sigaction action;
+      std::memset(static_cast<void*>(&action), 0, sizeof(action));
+      action.sa_sigaction = fault;
+      action.sa_flags = SA_SIGINFO;
+      sigemptyset(&action.sa_mask);
+      sigaction(SIGSEGV, &action, &previous);
+      return true;
+    }
+
+   // Returns false if the chunk is damaged. Then it is zeros, so that the touch that found it can go on,
+   // and the Machine has an invalid operation, so that the engine stops at the end of the cycle.
+   bool fill(size_t chunk)
+    {
+      unsigned char expected = 0U;
+      if (true == state[chunk].compare_exchange_strong(expected, 1U))
+       {
+         const size_t at = chunk * PACK_CHUNK;
+         const size_t raw = std::min(PACK_CHUNK, bytes - at);
+         const size_t span = (raw + page - 1U) / page * page;
+         unsigned int packed;
+         std::memcpy(static_cast<void*>(&packed), static_cast<const void*>(image + chunks[chunk] + 4U), sizeof(packed));
+         void * fresh = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         bool good = (MAP_FAILED != fresh) && (chunks[chunk] + 8U + packed <= imageSize) &&
+            (true == Packer::unpack(image + chunks[chunk] + 8U, packed, static_cast<unsigned char*>(fresh), raw)) &&
+            (MAP_FAILED != mremap(fresh, span, span, MREMAP_MAYMOVE | MREMAP_FIXED, static_cast<void*>(base + at)));
+         if (true == good)
           {
-            addNops += frame->flow_retire[i].nops;
+            state[chunk].store(2U);
+            return true;
           }
-         frame->alunop += addNops;
-         addNops = 0U;
-         for (size_t i = 0U; i < ALUNITS; ++i)
+         if (MAP_FAILED != fresh)
           {
-            addNops += frame->alu_retire[i].nops;
+            munmap(fresh, span);
           }
-         frame->flownop += addNops;
-//  Retire ALUs
-         for (size_t i = 0U; i < ALUNITS; ++i)
+         const bool zeroed = (MAP_FAILED != mmap(static_cast<void*>(base + at), span, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0));
+         *invalidOp = true;
+         damaged.store(true);
+         state[chunk].store(zeroed ? 3U : 4U);
+         return false;
+       }
+      while (1U == state[chunk].load())
+       {
+         sched_yield();
+       }
+      return 2U == state[chunk].load();
+    }
+
+   // Whether the chunk can now be touched.
+   bool mapped(size_t chunk) const
+    {
+      return state[chunk].load() < 4U;
+    }
+
+   // Unpack everything over [begin, end) bytes, before something else is put there.
+   void fill(size_t begin, size_t end)
+    {
+      for (size_t chunk = begin / PACK_CHUNK; (chunk < chunks.size()) && (chunk * PACK_CHUNK < end); ++chunk)
+       {
+         fill(chunk);
+       }
+    }
+
+   static void fault(int number, siginfo_t * info, void * context)
+    {
+      char * at = static_cast<char*>(info->si_addr);
+      for (size_t i = 0U; i < SLOTS; ++i)
+       {
+         LazyMemory* lazy = active[i].load();
+         if ((NULL != lazy) && (at >= lazy->base) && (at < lazy->base + lazy->bytes))
           {
-            for (size_t j = 0U; (j < ALU_RETIRE_SIZE) && (0U == (EMPTY & frame->alu_retire[i].fast[j])); ++j)
-             {
-               retire(*frame, frame->alu_retire[i].fast[j]);
-             }
-            for (size_t j = 0U; (j < ALU_RETIRE_SIZE) && (0U == (EMPTY & frame->alu_retire[i].slow[j])); ++j)
+            const size_t chunk = static_cast<size_t>(at - lazy->base) / PACK_CHUNK;
+            lazy->fill(chunk);
+            if (true == lazy->mapped(chunk)) // Damaged is zeros, and left to the engine to report
              {
-               slowretire(*frame, frame->alu_retire[i].slow[j]);
+               return;
              }
+            break;
           }
-//  Retire Flows
-         for (size_t i = 0U; i < FLOW_UNITS; ++i)
-          {
-            for (size_t j = 0U; (j < FLOW_RETIRE_SIZE) && (0U == (EMPTY & frame->flow_retire[i].fast[j])); ++j)
-             {
-               retire(*frame, frame->flow_retire[i].fast[j]);
+       }
+      // Not ours (or nothing could be mapped there): it is for whoever had the signal before.
+      if (0 != (previous.sa_flags & SA_SIGINFO))
+       {
+         previous.sa_sigaction(number, info, context);
+       }
+      else if ((SIG_DFL != previous.sa_handler) && (SIG_IGN != previous.sa_handler))
+       {
+         previous.sa_handler(number);
+       }
+      else
+       {
+         sigaction(SIGSEGV, &previous, NULL); // Take the fault again, for real.
+       }
+    }
+ };
+
+std::atomic<LazyMemory*> LazyMemory::active [LazyMemory::SLOTS];
+struct sigaction LazyMemory::previous;
+#endif
+
+#ifdef __linux__
+#define MILL_SNAPSHOT_MEMFD
+#endif
+
+// A Machine as it was, kept in this process to go back to. With a memfd, memory is written out once,
+// and then the Machine's memory becomes a copy-on-write mapping of it: going back is one mmap, plus
+// dropping what was decoded from the pages stored to since.
+class Snapshot
+ {
+public:
+   std::vector<Frame> frames;
+   ALURetire alu_retire [MAX_ALUNITS];
+   FlowRetire flow_retire [FLOW_UNITS];
+   std::vector<FlowRetire> parked;
+   size_t memsize;
+   bool terminate;
+   bool invalidOp;
+   bool stop;
+#ifdef MILL_STATS
+   Counters counters;
+#endif
+#ifdef MILL_SNAPSHOT_MEMFD
+   int fd;
+#else
+   std::vector<MEM_T> words;
+#endif
+
+   Snapshot() : memsize(0U), terminate(false), invalidOp(false), stop(false)
+    {
+#ifdef MILL_SNAPSHOT_MEMFD
+      fd = -1;
+#endif
+    }
+
+   ~Snapshot()
+    {
+#ifdef MILL_SNAPSHOT_MEMFD
+      if (-1 != fd)
+       {
+         close(fd);
+       }
+#endif
+    }
+ };
+
+class JobIO;
+
+class Machine
+ {
+public:
+   FrameStack frames;
+   // The retire stations. Only the running frame uses them.
+   ALURetire alu_retire [MAX_ALUNITS];
+   FlowRetire flow_retire [FLOW_UNITS];
+   // When a flow unit calls, the stations of the units after it haven't been retired.
+   // They wait here for the return.
+   std::vector<FlowRetire> parked;
+   MEM_T * memory;
+   size_t memsize;
+   size_t width; // ALU slots a cycle: one of ALU_WIDTHS, as the image says
+   bool terminate;
+   bool invalidOp;
+   bool stop;
+
+   // Decoded instructions, by word address. Filled in when first executed, and invalidated by stores.
+   // Each stream decodes the same word differently, so each gets a table.
+   std::vector<ALUDecoded> aluDecoded;
+   std::vector<FlowDecoded> flowDecoded;
+   // Words that have been translated into a trace, and whether one of them has since been stored to.
+   std::vector<unsigned char> traced;
+   bool tracesStale;
+   // Pages stored to since the last checkpoint, and since the last snapshot.
+   std::vector<unsigned char> dirty;
+   const Snapshot* mark; // What SINCE_SNAPSHOT is relative to
+   bool warming; // The first request for input leaves its cycle undone and sets warm
+   bool warm;
+   bool packCores; // Whether save packs a Core, or lays it out to be mapped
+#ifdef MILL_STATS
+   Counters counters;
+#endif
+   Recorder* recorder; // Given the stores, when there is one
+   JobIO* job; // Under -batch, where the guest's input comes from and its output goes; otherwise NULL, for the host's
+#ifdef MILL_LAZY_CORE
+   LazyMemory* lazy; // Memory that is still to be unpacked
+#endif
+
+   Machine() : memory(NULL), memsize(0U), width(DEFAULT_ALUNITS), terminate(false), invalidOp(false), stop(false), tracesStale(false), mark(NULL), warming(false), warm(false), packCores(true),
+      recorder(NULL), job(NULL)
+    {
+#ifdef MILL_LAZY_CORE
+      lazy = NULL;
+#endif
+      frames.push().init();
+      for (size_t i = 0U; i < MAX_ALUNITS; ++i) alu_retire[i].flush();
+    }
+
+   ~Machine()
+    {
+      allocate(0U); // A -batch worker goes through many machines.
+    }
+
+   void setWidth(size_t units)
+    {
+      width = units;
+#ifdef MILL_STATS
+      counters.width = units;
+#endif
+    }
+
+   // What goes after the size of a size in the header of a Core or Delt: the width, or a space for the default.
+   char widthTag() const
+    {
+      return (DEFAULT_ALUNITS == width) ? ' ' : static_cast<char>('0' + width);
+    }
+
+   // Call once memory is loaded, before running.
+   void prepare()
+    {
+      aluDecoded.assign(memsize, ALUDecoded());
+      flowDecoded.assign(memsize, FlowDecoded());
+      traced.assign(memsize, 0U);
+      tracesStale = false;
+      dirty.assign((memsize + PAGE_WORDS - 1U) / PAGE_WORDS, 0U);
+    }
+
+   // Memory is an anonymous mapping, so that the pages of an image can be mapped over it.
+   void allocate(size_t size)
+    {
+#ifdef MILL_LAZY_CORE
+      delete lazy;
+      lazy = NULL;
+#endif
+      if (NULL != memory)
+       {
+         munmap(static_cast<void*>(memory), memsize * sizeof(MEM_T));
+       }
+      memsize = size;
+      memory = NULL;
+      if (0U != size)
+       {
+         void * map = mmap(NULL, size * sizeof(MEM_T), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         memory = (MAP_FAILED == map) ? NULL : static_cast<MEM_T*>(map);
+       }
+    }
+
+   // Load count words at file offset into memory at entry. Whole pages are mapped copy-on-write
+   // when the offset and the address agree modulo the page size; the rest is read.
+   // Returns false on a short file.
+   bool load(int fd, size_t offset, size_t entry, size_t count)
+    {
+      settle(entry, count);
+      const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      struct stat info;
+      const size_t fileSize = (0 == fstat(fd, &info)) ? static_cast<size_t>(info.st_size) : 0U;
+      const size_t begin = entry * sizeof(MEM_T);
+      const size_t end = begin + count * sizeof(MEM_T);
+      char * base = static_cast<char*>(static_cast<void*>(memory));
+      // Never map past the end of the file: touching that page would be a SIGBUS, not a short read.
+      if (((offset % page) == (begin % page)) && (offset + (end - begin) <= fileSize))
+       {
+         const size_t first = (begin + page - 1U) / page * page;
+         const size_t last = end / page * page;
+         if ((first < last) && (MAP_FAILED != mmap(static_cast<void*>(base + first), last - first,
+               PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(offset + (first - begin)))))
+          {
+            return copy(fd, offset, base + begin, first - begin) &&
+               copy(fd, offset + (last - begin), base + last, end - last);
+          }
+       }
+      return copy(fd, offset, base + begin, end - begin);
+    }
+
+   // Zero count words at entry. Whole pages get fresh anonymous pages, which cost nothing until they are touched.
+   void zero(size_t entry, size_t count)
+    {
+      settle(entry, count);
+      const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      const size_t begin = entry * sizeof(MEM_T);
+      const size_t end = begin + count * sizeof(MEM_T);
+      const size_t first = std::min(end, (begin + page - 1U) / page * page);
+      const size_t last = std::max(first, end / page * page);
+      char * base = static_cast<char*>(static_cast<void*>(memory));
+      if ((first == last) || (MAP_FAILED == mmap(static_cast<void*>(base + first), last - first,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0)))
+       {
+         std::memset(static_cast<void*>(base + begin), 0, end - begin);
+         return;
+       }
+      std::memset(static_cast<void*>(base + begin), 0, first - begin);
+      std::memset(static_cast<void*>(base + last), 0, end - last);
+    }
+
+   // Returns false if memory couldn't be kept.
+   bool snapshot(Snapshot& snap)
+    {
+      settle(0U, memsize);
+      snap.frames.clear();
+      for (size_t i = 0U; i < frames.size(); ++i)
+       {
+         snap.frames.push_back(frames[i]);
+       }
+      std::copy(alu_retire, alu_retire + MAX_ALUNITS, snap.alu_retire);
+      std::copy(flow_retire, flow_retire + FLOW_UNITS, snap.flow_retire);
+      snap.parked = parked;
+      snap.memsize = memsize;
+      snap.terminate = terminate;
+      snap.invalidOp = invalidOp;
+      snap.stop = stop;
+#ifdef MILL_STATS
+      snap.counters = counters;
+#endif
+#ifdef MILL_SNAPSHOT_MEMFD
+      const size_t bytes = memsize * sizeof(MEM_T);
+      if (-1 != snap.fd)
+       {
+         close(snap.fd);
+       }
+      snap.fd = memfd_create("MillULX", 0);
+      if ((-1 == snap.fd) || (0 != ftruncate(snap.fd, static_cast<off_t>(bytes))))
+       {
+         return false;
+       }
+      for (size_t at = 0U; at < bytes; )
+       {
+         const ssize_t put = pwrite(snap.fd, static_cast<const char*>(static_cast<void*>(memory)) + at, bytes - at, static_cast<off_t>(at));
+         if (put <= 0)
+          {
+            return false;
+          }
+         at += static_cast<size_t>(put);
+       }
+      if ((0U != bytes) && (MAP_FAILED == mmap(static_cast<void*>(memory), bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, snap.fd, 0)))
+       {
+         return false;
+       }
+#else
+      snap.words.assign(memory, memory + memsize);
+#endif
+      for (size_t i = 0U; i < dirty.size(); ++i)
+       {
+         dirty[i] &= ~SINCE_SNAPSHOT;
+       }
+      mark = &snap;
+      return true;
+    }
+
+   // Go back to a snapshot of this Machine. Returns false if it doesn't fit.
+   bool restore(const Snapshot& snap)
+    {
+      if (snap.memsize != memsize)
+       {
+         return false;
+       }
+      frames.clear();
+      for (size_t i = 0U; i < snap.frames.size(); ++i)
+       {
+         frames.push() = snap.frames[i];
+       }
+      std::copy(snap.alu_retire, snap.alu_retire + MAX_ALUNITS, alu_retire);
+      std::copy(snap.flow_retire, snap.flow_retire + FLOW_UNITS, flow_retire);
+      parked = snap.parked;
+      terminate = snap.terminate;
+      invalidOp = snap.invalidOp;
+      stop = snap.stop;
+#ifdef MILL_STATS
+      counters = snap.counters;
+#endif
+#ifdef MILL_SNAPSHOT_MEMFD
+      if ((0U != memsize) && (MAP_FAILED == mmap(static_cast<void*>(memory), memsize * sizeof(MEM_T),
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, snap.fd, 0)))
+       {
+         return false;
+       }
+#endif
+      // Only the pages stored to since the snapshot differ from it. Otherwise, any page may.
+      for (size_t i = 0U; i < dirty.size(); ++i)
+       {
+         if ((&snap != mark) || (0U != (SINCE_SNAPSHOT & dirty[i])))
+          {
+            const size_t end = std::min(memsize, (i + 1U) * PAGE_WORDS);
+#ifndef MILL_SNAPSHOT_MEMFD
+            std::copy(snap.words.begin() + i * PAGE_WORDS, snap.words.begin() + end, memory + i * PAGE_WORDS);
+#endif
+            for (size_t j = i * PAGE_WORDS; j < end; ++j)
+             {
+               invalidate(j);
              }
-            if (0U == (EMPTY & frame->flow_retire[i].slow))
+          }
+         dirty[i] &= ~SINCE_SNAPSHOT;
+       }
+      mark = &snap;
+      return true;
+    }
+
+   // Unpack what of a packed Core is still to come over count words at entry, before they are replaced.
+   void settle(size_t entry, size_t count)
+    {
+#ifdef MILL_LAZY_CORE
+      if (NULL != lazy)
+       {
+         lazy->fill(entry * sizeof(MEM_T), (entry + count) * sizeof(MEM_T));
+       }
+#else
+      static_cast<void>(entry);
+      static_cast<void>(count);
+#endif
+    }
+
+   static bool copy(int fd, size_t offset, char * to, size_t bytes)
+    {
+      while (bytes > 0U)
+       {
+         ssize_t got = pread(fd, static_cast<void*>(to), bytes, static_cast<off_t>(offset));
+         if (got <= 0)
+          {
+            return false;
+          }
+         to += got;
+         offset += static_cast<size_t>(got);
+         bytes -= static_cast<size_t>(got);
+       }
+      return true;
+    }
+
+   void invalidate(size_t location)
+    {
+      aluDecoded[location].code = UNDECODED;
+      flowDecoded[location].code = UNDECODED;
+      dirty[location / PAGE_WORDS] = SINCE_CHECKPOINT | SINCE_SNAPSHOT;
+      if (0U != traced[location])
+       {
+         tracesStale = true;
+       }
+      if (NULL != recorder)
+       {
+         recorder->add(Recorder::STORE, location, memory[location]);
+       }
+    }
+
+   // Everything decoded from, or traced through, the words that count bytes at the byte address at touched is stale.
+   // Each word is invalidated (and recorded) once, however many of its bytes were stored.
+   void invalidateBytes(size_t at, size_t count)
+    {
+      if (0U == count)
+       {
+         return;
+       }
+      for (size_t word = at / sizeof(MEM_T); word <= (at + count - 1U) / sizeof(MEM_T); ++word)
+       {
+         invalidate(word);
+       }
+    }
+
+   // Write a Core image to a new file, and then rename it to name: memory may still be mapped from the old one.
+   void save(const char * name)
+    {
+      std::string temp = std::string(name) + ".new";
+      std::FILE * file = std::fopen(temp.c_str(), "wb");
+      if (NULL == file)
+       {
+         return;
+       }
+      writeCore(file);
+      std::fclose(file);
+      std::rename(temp.c_str(), name);
+    }
+
+   // A whole Core, header and all.
+   void writeCore(std::FILE * file)
+    {
+      std::fprintf(file, "Mill%s%d%c%s%s", endian(), static_cast<int>(sizeof(size_t)), widthTag(), CORE_TAG, packCores ? "Pack" : "Page");
+      // As simple and elegant as this SEEMS, it is always a bad way to structure the code.
+      if (true == packCores)
+       {
+         writePacked(file);
+       }
+      else
+       {
+         write(file);
+       }
+    }
+
+   // Writes the "Page" layout: memory starts on an IMAGE_PAGE boundary of the file.
+   void write(std::FILE * file)
+    {
+      std::fwrite(static_cast<void*>(&memsize), sizeof(size_t), 1U, file);
+      imagePad(file, 0U);
+      settle(0U, memsize); // The kernel doesn't fault pages in for a write(): it fails.
+      std::fwrite(static_cast<void*>(memory), sizeof(MEM_T), memsize, file);
+      writeFrames(file);
+    }
+
+   // "Mill" "LE? " "Core" "Pack" memory_size frame_bytes {chunk} {chunk}
+   // The frame stack as writeFrames writes it, and then memory, through Packer. The frame stack
+   // comes first so that a reader can start before it has unpacked memory.
+   void writePacked(std::FILE * file)
+    {
+      char * stack = NULL;
+      size_t header [2U] = { memsize, 0U };
+      std::FILE * frameFile = open_memstream(&stack, &header[1U]);
+      writeFrames(frameFile);
+      std::fclose(frameFile);
+      std::fwrite(static_cast<void*>(header), sizeof(size_t), 2U, file);
+      Packer::write(file, stack, header[1U]);
+      std::free(stack);
+      Packer::write(file, memory, memsize * sizeof(MEM_T));
+    }
+
+   // "Mill" "LE? " "Delt" "Page" sequence memory_size num_pages {page} {pad {data_word}} num_frames { frames }
+   // The pages of memory stored to since checkpoint sequence - 1, and the whole frame stack.
+   void writeDelta(std::FILE * file, size_t sequence, const std::vector<size_t>& pages)
+    {
+      std::fprintf(file, "Mill%s%d%c%sPage", endian(), static_cast<int>(sizeof(size_t)), widthTag(), DELTA_TAG);
+      std::fwrite(static_cast<void*>(&sequence), sizeof(size_t), 1U, file);
+      std::fwrite(static_cast<void*>(&memsize), sizeof(size_t), 1U, file);
+      size_t numPages = pages.size();
+      std::fwrite(static_cast<void*>(&numPages), sizeof(size_t), 1U, file);
+      if (0U != numPages)
+       {
+         std::fwrite(static_cast<const void*>(&pages[0U]), sizeof(size_t), numPages, file);
+       }
+      for (size_t i = 0U; i < numPages; ++i)
+       {
+         const size_t entry = pages[i] * PAGE_WORDS;
+         imagePad(file, entry);
+         std::fwrite(static_cast<void*>(memory + entry), sizeof(MEM_T), std::min(PAGE_WORDS, memsize - entry), file);
+       }
+      writeFrames(file);
+    }
+
+   void writeFrames(std::FILE * file)
+    {
+      size_t framesSize = frames.size();
+      std::fwrite(static_cast<void*>(&framesSize), sizeof(size_t), 1U, file);
+      // Each Frame is followed by its retire stations: the real ones for the running frame,
+      // and empty ones (but for what is parked) for the callers.
+      ALURetire idleALU;
+      idleALU.flush();
+      FlowRetire idleFlow;
+      size_t park = 0U;
+      for (size_t i = 0U; i < framesSize; ++i)
+       {
+         const bool running = (i + 1U == framesSize);
+         frames[i].write(file);
+         for (size_t j = 0U; j < width; ++j)
+          {
+            (running ? alu_retire[j] : idleALU).write(file);
+          }
+         for (size_t j = 0U; j < FLOW_UNITS; ++j)
+          {
+            if (true == running)
              {
-               slowretire(*frame, frame->flow_retire[i].slow);
+               flow_retire[j].write(file);
              }
-            // The first non-call branch wins and stops flow unit processing
-            if ((0U == frame->nextpc) && (0U != frame->flow_retire[i].jump) && (SIGNAL_CALL != frame->flow_retire[i].use))
+            else if (j > frames[i].index)
              {
-               frame->nextpc = frame->flow_retire[i].jump;
-               break;
+               parked[park++].write(file);
              }
-            switch (frame->flow_retire[i].use)
+            else
              {
-               case NOT_IN_USE:
-                  break;
-               case CANON:
-                  frame->ffront = 0U;
-                  frame->fsize = 0U;
-                  for (size_t j = 0U; (j < BELT_SIZE) && (0U == (EMPTY & frame->flow_retire[i].belt[j])); ++j)
-                   {
-                     retire(*frame, frame->flow_retire[i].belt[j]);
-                   }
-                  break;
-               case SLOW_CANON:
-                  frame->sfront = 0U;
-                  frame->ssize = 0U;
-                  for (size_t j = 0U; (j < BELT_SIZE) && (0U == (EMPTY & frame->flow_retire[i].belt[j])); ++j)
-                   {
-                     slowretire(*frame, frame->flow_retire[i].belt[j]);
-                   }
-                  break;
-               case SIGNAL_CALL:
-                {
-                  frame->index = i; // When we return, we will return to this index.
-                  // The retire phase has been carefully constructed so that (hopefully) we can treat a call as an instruction
-                  // that retires a variable number of values.
-                  // And that we can create and destroy frames in this loop without invalidating the machine state.
-                  machine->frames.push_back(Frame());
-                  Frame* prevFrame = &machine->frames[machine->frames.size() - 2U]; // Don't use frame
-                  frame = &machine->frames.back();
-                  frame->init();
-                  for (size_t j = 0U; (j < BELT_SIZE) && (0U == (EMPTY & prevFrame->flow_retire[i].belt[j])); ++j)
-                   {
-                     retire(*frame, prevFrame->flow_retire[i].belt[j]);
-                   }
-                  frame->nextpc = prevFrame->flow_retire[i].jump;
-                  i = FLOW_UNITS; // Don't process any of the new frame's flow retire stations.
-                }
-                  break;
-               case SIGNAL_RETURN:
-                  if (1U != machine->frames.size())
-                   {
-                     Frame* prevFrame = &machine->frames[machine->frames.size() - 2U];
-                     for (size_t j = 0U; (j < BELT_SIZE) && (0U == (EMPTY & frame->flow_retire[i].belt[j])); ++j)
-                      {
-                        retire(*prevFrame, frame->flow_retire[i].belt[j]);
-                      }
-                     machine->frames.pop_back();
-                     frame = &machine->frames.back(); // Don't use prevFrame.
-                     i = frame->index;
-                   }
-                  else
-                   {
-                     // Returning from the bottommost frame exits.
-                     machine->stop = true;
-                   }
-                  break;
+               idleFlow.write(file);
              }
           }
-         if (0U != frame->nextpc)
+       }
+    }
+
+   // Read a Core, with the file past the tag. layout is the four bytes that follow it.
+   // Returns false if it is damaged.
+   bool read(std::FILE * file, const char * layout)
+    {
+      if (0 == std::strncmp(layout, "Pack", 4U))
+       {
+         return readPacked(file);
+       }
+      const bool paged = (0 == std::strncmp(layout, "Page", 4U));
+      size_t size = 0U;
+      if ((1U != std::fread(static_cast<void*>(&size), sizeof(size_t), 1U, file)) || (size > remaining(file) / sizeof(MEM_T)))
+       {
+         return false;
+       }
+      allocate(size);
+      size_t offset = static_cast<size_t>(std::ftell(file));
+      if (true == paged)
+       {
+         offset = imageAlign(offset, 0U);
+       }
+      if (false == load(fileno(file), offset, 0U, memsize))
+       {
+         return false;
+       }
+      std::fseek(file, static_cast<long>(offset + memsize * sizeof(MEM_T)), SEEK_SET);
+      return readFrames(file);
+    }
+
+   bool readPacked(std::FILE * file)
+    {
+      size_t header [2U] = { 0U, 0U };
+      // Sizes that the rest of the file can't hold are damage, and mustn't be allocated.
+      if ((2U != std::fread(static_cast<void*>(header), sizeof(size_t), 2U, file)) ||
+          (0U == header[1U]) || (header[1U] > Packer::reach(remaining(file))))
+       {
+         return false;
+       }
+      std::vector<unsigned char> stack (header[1U] + 1U);
+      if (false == Packer::read(file, &stack[0U], header[1U]))
+       {
+         return false;
+       }
+      std::FILE * frameFile = fmemopen(&stack[0U], header[1U], "rb");
+      if (NULL == frameFile)
+       {
+         return false;
+       }
+      const bool framed = readFrames(frameFile);
+      std::fclose(frameFile);
+      if ((false == framed) || (header[0U] > Packer::reach(remaining(file)) / sizeof(MEM_T)))
+       {
+         return false;
+       }
+      allocate(header[0U]);
+#ifdef MILL_LAZY_CORE
+      lazy = LazyMemory::open(file, memory, memsize, invalidOp);
+      if (NULL != lazy)
+       {
+         return true;
+       }
+#endif
+      return Packer::read(file, memory, memsize * sizeof(MEM_T));
+    }
+
+   // Apply a delta to the checkpoint before it, with the header read up to the sequence.
+   // Returns false if it doesn't fit.
+   bool readDelta(std::FILE * file, size_t sequence)
+    {
+      size_t check [3] = { 0U, 0U, 0U };
+      std::fread(static_cast<void*>(check), sizeof(size_t), 3U, file);
+      if ((sequence != check[0]) || (memsize != check[1]) || (check[2] > (memsize + PAGE_WORDS - 1U) / PAGE_WORDS))
+       {
+         return false;
+       }
+      std::vector<size_t> pages (check[2]);
+      if (0U != pages.size())
+       {
+         std::fread(static_cast<void*>(&pages[0U]), sizeof(size_t), pages.size(), file);
+       }
+      size_t offset = static_cast<size_t>(std::ftell(file));
+      for (size_t i = 0U; i < pages.size(); ++i)
+       {
+         const size_t entry = pages[i] * PAGE_WORDS;
+         if (entry >= memsize)
+          {
+            return false;
+          }
+         const size_t count = std::min(PAGE_WORDS, memsize - entry);
+         offset = imageAlign(offset, entry);
+         if (false == load(fileno(file), offset, entry, count))
           {
-            frame->alupc = frame->nextpc;
-            frame->flowpc = frame->nextpc;
-            frame->entryPoint = frame->nextpc;
-            frame->nextpc = 0U;
+            return false;
           }
-/*
-// You know you're in deep when you have to uncomment this block.
-std::printf("%x %x %x %x %x %x %x %x %x %x %x %x\n",
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 0)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 1)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 2)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 3)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 4)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 5)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 6)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 7)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 8)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 9)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 10)),
-   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 11)));
-*/
-         if ((true == machine->invalidOp) || (true == machine->stop))
+         offset += count * sizeof(MEM_T);
+       }
+      std::fseek(file, static_cast<long>(offset), SEEK_SET);
+      return readFrames(file);
+    }
+
+   // The bytes of file after where it is.
+   static size_t remaining(std::FILE * file)
+    {
+      const long at = std::ftell(file);
+      if ((at < 0L) || (0 != std::fseek(file, 0L, SEEK_END)))
+       {
+         return 0U;
+       }
+      const long end = std::ftell(file);
+      std::fseek(file, at, SEEK_SET);
+      return (end > at) ? static_cast<size_t>(end - at) : 0U;
+    }
+
+   // Returns false if the file runs out, or doesn't hold a frame stack: there is always the bottommost frame.
+   bool readFrames(std::FILE * file)
+    {
+      size_t framesSize = 0U;
+      if ((1U != std::fread(static_cast<void*>(&framesSize), sizeof(size_t), 1U, file)) ||
+          (0U == framesSize) || (framesSize > remaining(file) / sizeof(size_t)))
+       {
+         return false;
+       }
+      frames.clear();
+      parked.clear();
+      ALURetire idleALU;
+      FlowRetire idleFlow;
+      for (size_t i = 0U; i < framesSize; ++i)
+       {
+         const bool running = (i + 1U == framesSize);
+         Frame& frame = frames.push();
+         frame.read(file);
+         for (size_t j = 0U; j < width; ++j)
+          {
+            (running ? alu_retire[j] : idleALU).read(file);
+          }
+         for (size_t j = 0U; j < FLOW_UNITS; ++j)
+          {
+            if (true == running)
+             {
+               flow_retire[j].read(file);
+             }
+            else if (j > frame.index)
+             {
+               parked.push_back(FlowRetire());
+               parked.back().read(file);
+             }
+            else
+             {
+               idleFlow.read(file);
+             }
+          }
+         if ((0 != std::feof(file)) || (0 != std::ferror(file)))
+          {
+            return false;
+          }
+       }
+      return true;
+    }
+ };
+
+// The guest's standard input and output. Output goes through stdout, which gets a big buffer when it
+// isn't a terminal, so that a range is one fwrite (and one write(), when it doesn't fit in the buffer).
+// Input is buffered here rather than by stdio, so that getchar and ranges read the same stream, and a
+// range can be read straight into memory.
+class HostIO
+ {
+public:
+   static const size_t BUFFER = 65536U;
+   static unsigned char input [BUFFER];
+   static size_t inputAt;
+   static size_t inputEnd;
+
+   static void init()
+    {
+      if (0 == isatty(1))
+       {
+         std::setvbuf(stdout, NULL, _IOFBF, BUFFER);
+       }
+    }
+
+   // Once the guest polls, the input is read by a thread of its own into this ring, and the buffer is refilled from it.
+   // Only the reader moves the tail, and only the core moves the head.
+   static const unsigned int RING = 65536U;
+   static unsigned char ring [RING];
+   static std::atomic<unsigned int> ringHead;
+   static std::atomic<unsigned int> ringTail;
+   static std::atomic<bool> ended;
+   static std::atomic<int> events; // Bumped by the reader after each read, for the core to sleep on
+   static std::atomic<int> sleepers;
+   static bool reading;
+   static int stopPipe [2];
+   static pthread_t reader;
+
+   static void publish()
+    {
+      events.fetch_add(1, std::memory_order_seq_cst);
+      if (0 != sleepers.load(std::memory_order_seq_cst))
+       {
+#ifdef __linux__
+         syscall(SYS_futex, reinterpret_cast<int*>(&events), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+       }
+    }
+
+   static void * readInput(void *)
+    {
+      for (;;)
+       {
+         const unsigned int tail = ringTail.load(std::memory_order_relaxed);
+         const unsigned int room = RING - (tail - ringHead.load(std::memory_order_acquire));
+         pollfd fds [2] = { { stopPipe[0], POLLIN, 0 }, { 0, POLLIN, 0 } };
+         // With the ring full, just look in now and then for being stopped.
+         ::poll(fds, (0U == room) ? 1U : 2U, (0U == room) ? 1 : -1);
+         if (0 != fds[0].revents)
+          {
+            return NULL;
+          }
+         if (0 == fds[1].revents)
+          {
+            continue;
+          }
+         const unsigned int at = tail % RING;
+         const ssize_t got = ::read(0, static_cast<void*>(ring + at), std::min(room, RING - at));
+         if (got <= 0)
+          {
+            ended.store(true, std::memory_order_release);
+            publish();
+            return NULL;
+          }
+         ringTail.store(tail + static_cast<unsigned int>(got), std::memory_order_release);
+         publish();
+       }
+    }
+
+   static void start()
+    {
+      if ((false == reading) && (0 == pipe(stopPipe)))
+       {
+         reading = (0 == pthread_create(&reader, NULL, &readInput, NULL));
+       }
+    }
+
+   // Whether there is input in the ring. Returns false at the end of the input, or when it shouldn't wait and there is none yet.
+   static bool await(bool wait)
+    {
+      for (;;)
+       {
+         const int seen = events.load(std::memory_order_seq_cst);
+         const bool over = ended.load(std::memory_order_acquire); // The last of the input is in by the time this is set
+         if (ringTail.load(std::memory_order_acquire) != ringHead.load(std::memory_order_relaxed))
+          {
+            return true;
+          }
+         if ((true == over) || (false == wait))
+          {
+            return false;
+          }
+         sleepers.fetch_add(1, std::memory_order_seq_cst);
+#ifdef __linux__
+         syscall(SYS_futex, reinterpret_cast<int*>(&events), FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+         sched_yield();
+#endif
+         sleepers.fetch_sub(1, std::memory_order_seq_cst);
+       }
+    }
+
+   // Refill the buffer, which has been used up. Returns false if there is nothing to refill it with (yet).
+   static bool fill(bool wait)
+    {
+      inputAt = 0U;
+      inputEnd = 0U;
+      if (true == wait)
+       {
+         std::fflush(stdout); // Whatever asked for this has been seen.
+       }
+      if (false == reading)
+       {
+         const ssize_t got = ::read(0, static_cast<void*>(input), BUFFER);
+         inputEnd = (got > 0) ? static_cast<size_t>(got) : 0U;
+         return 0U != inputEnd;
+       }
+      if (false == await(wait))
+       {
+         return false;
+       }
+      const unsigned int head = ringHead.load(std::memory_order_relaxed);
+      const unsigned int count = std::min(static_cast<unsigned int>(BUFFER), ringTail.load(std::memory_order_acquire) - head);
+      const unsigned int at = head % RING;
+      const unsigned int first = std::min(count, RING - at);
+      std::memcpy(static_cast<void*>(input), static_cast<const void*>(ring + at), first);
+      std::memcpy(static_cast<void*>(input + first), static_cast<const void*>(ring), count - first);
+      ringHead.store(head + count, std::memory_order_release);
+      inputEnd = count;
+      return true;
+    }
+
+   // Throw away what has been read ahead, and stop the reader.
+   static void discard()
+    {
+      inputAt = 0U;
+      inputEnd = 0U;
+      if (true == reading)
+       {
+         const char stop = 0;
+         if (1 == ::write(stopPipe[1], &stop, 1U))
+          {
+            pthread_join(reader, NULL);
+          }
+         close(stopPipe[0]);
+         close(stopPipe[1]);
+         reading = false;
+         ringHead.store(0U);
+         ringTail.store(0U);
+         ended.store(false);
+       }
+    }
+
+   // Returns EOF at the end of the input.
+   static int getByte()
+    {
+      if ((inputAt == inputEnd) && (false == fill(true)))
+       {
+         return EOF;
+       }
+      return input[inputAt++];
+    }
+
+   // How much input there is that can be had without waiting, or EOF if it has all been had.
+   static BELT_T poll()
+    {
+      start();
+      const size_t buffered = inputEnd - inputAt;
+      if ((0U == buffered) && (false == await(false)) && (true == ended.load(std::memory_order_acquire)))
+       {
+         return EOF & 0xFFFFFFFFLL;
+       }
+      return static_cast<BELT_T>(buffered + (ringTail.load(std::memory_order_acquire) - ringHead.load(std::memory_order_relaxed)));
+    }
+
+   // Whether [address, address + length) are bytes of memory. Bytes are numbered as ldb and stb number them.
+   static bool inside(const Machine& machine, BELT_T address, BELT_T length)
+    {
+      const size_t bytes = machine.memsize * sizeof(MEM_T);
+      return (0U == ((address | length) & (INVALID | TRANSIENT))) && (static_cast<size_t>(address & 0xFFFFFFFFLL) <= bytes) &&
+         (static_cast<size_t>(length & 0xFFFFFFFFLL) <= bytes - static_cast<size_t>(address & 0xFFFFFFFFLL));
+    }
+
+   static void settle(Machine& machine, size_t from, size_t count)
+    {
+      const size_t first = from / sizeof(MEM_T);
+      machine.settle(first, (from + count + sizeof(MEM_T) - 1U) / sizeof(MEM_T) - first);
+    }
+
+   static bool littleEndian()
+    {
+      return 0 == std::strncmp("LE", endian(), 2U);
+    }
+
+   // Returns how many bytes were written, or INVALID.
+   static BELT_T write(Machine& machine, BELT_T address, BELT_T length)
+    {
+      if (false == inside(machine, address, length))
+       {
+         return INVALID;
+       }
+      const size_t from = static_cast<size_t>(address & 0xFFFFFFFFLL);
+      const size_t count = static_cast<size_t>(length & 0xFFFFFFFFLL);
+      settle(machine, from, count); // stdio may hand it straight to the kernel
+      if (true == littleEndian())
+       {
+         std::fwrite(static_cast<const void*>(static_cast<const char*>(static_cast<void*>(machine.memory)) + from), 1U, count, stdout);
+       }
+      else
+       {
+         for (size_t i = from; i < from + count; ++i)
+          {
+            std::putchar(static_cast<int>((machine.memory[i / sizeof(MEM_T)] >> (8U * (i % sizeof(MEM_T)))) & 0xFFU));
+          }
+       }
+      return static_cast<BELT_T>(count);
+    }
+
+   // Read what input there is, up to length bytes. Returns how many, 0 at the end of the input, or INVALID.
+   // If it shouldn't wait and there is no input yet, returns TRANSIENT.
+   static BELT_T read(Machine& machine, BELT_T address, BELT_T length, bool wait)
+    {
+      if (false == inside(machine, address, length))
+       {
+         return INVALID;
+       }
+      const size_t from = static_cast<size_t>(address & 0xFFFFFFFFLL);
+      const size_t count = static_cast<size_t>(length & 0xFFFFFFFFLL);
+      unsigned char * to = static_cast<unsigned char*>(static_cast<void*>(machine.memory)) + from;
+      std::vector<unsigned char> swapped;
+      const bool swap = (false == littleEndian());
+      if (true == swap)
+       {
+         swapped.resize(count + 1U);
+         to = &swapped[0U];
+       }
+      settle(machine, from, count); // The kernel won't fault it in
+      size_t got = 0U;
+      if ((inputAt == inputEnd) && (0U != count) && (false == reading)) // Straight into memory
+       {
+         std::fflush(stdout);
+         const ssize_t direct = ::read(0, static_cast<void*>(to), count);
+         got = (direct > 0) ? static_cast<size_t>(direct) : 0U;
+       }
+      else
+       {
+         if ((inputAt == inputEnd) && (0U != count) && (false == fill(wait)))
+          {
+            return ((true == wait) || (true == ended.load(std::memory_order_acquire))) ? 0U : TRANSIENT;
+          }
+         got = std::min(count, inputEnd - inputAt);
+         std::memcpy(static_cast<void*>(to), static_cast<const void*>(input + inputAt), got);
+         inputAt += got;
+       }
+      for (size_t i = from; (true == swap) && (i < from + got); ++i)
+       {
+         MEM_T& word = machine.memory[i / sizeof(MEM_T)];
+         const unsigned int shift = 8U * (i % sizeof(MEM_T));
+         word = (word & ~(0xFFU << shift)) | (static_cast<MEM_T>(swapped[i - from]) << shift);
+       }
+      machine.invalidateBytes(from, got);
+      return static_cast<BELT_T>(got);
+    }
+ };
+
+unsigned char HostIO::input [HostIO::BUFFER];
+size_t HostIO::inputAt = 0U;
+size_t HostIO::inputEnd = 0U;
+unsigned char HostIO::ring [HostIO::RING];
+std::atomic<unsigned int> HostIO::ringHead (0U);
+std::atomic<unsigned int> HostIO::ringTail (0U);
+std::atomic<bool> HostIO::ended (false);
+std::atomic<int> HostIO::events (0);
+std::atomic<int> HostIO::sleepers (0);
+bool HostIO::reading = false;
+int HostIO::stopPipe [2];
+pthread_t HostIO::reader;
+
+// Under -batch, a job's I/O: its input is read in whole before it starts, and its output is kept until it ends.
+// So there is never anything to wait for, and jobs on different workers share nothing.
+class JobIO
+ {
+public:
+   std::vector<unsigned char> input;
+   size_t inputAt;
+   std::vector<unsigned char> output;
+
+   JobIO() : inputAt(0U) { }
+
+   int getByte()
+    {
+      return (inputAt < input.size()) ? input[inputAt++] : EOF;
+    }
+
+   BELT_T poll() const
+    {
+      return (inputAt < input.size()) ? static_cast<BELT_T>(input.size() - inputAt) : (EOF & 0xFFFFFFFFLL);
+    }
+
+   // As HostIO's, into and out of the buffers.
+   BELT_T write(Machine& machine, BELT_T address, BELT_T length)
+    {
+      if (false == HostIO::inside(machine, address, length))
+       {
+         return INVALID;
+       }
+      const size_t from = static_cast<size_t>(address & 0xFFFFFFFFLL);
+      const size_t count = static_cast<size_t>(length & 0xFFFFFFFFLL);
+      HostIO::settle(machine, from, count);
+      if (true == HostIO::littleEndian())
+       {
+         const unsigned char * bytes = static_cast<const unsigned char*>(static_cast<void*>(machine.memory));
+         output.insert(output.end(), bytes + from, bytes + from + count);
+       }
+      else
+       {
+         for (size_t i = from; i < from + count; ++i)
+          {
+            output.push_back(static_cast<unsigned char>((machine.memory[i / sizeof(MEM_T)] >> (8U * (i % sizeof(MEM_T)))) & 0xFFU));
+          }
+       }
+      return static_cast<BELT_T>(count);
+    }
+
+   BELT_T read(Machine& machine, BELT_T address, BELT_T length)
+    {
+      if (false == HostIO::inside(machine, address, length))
+       {
+         return INVALID;
+       }
+      const size_t from = static_cast<size_t>(address & 0xFFFFFFFFLL);
+      const size_t got = std::min(static_cast<size_t>(length & 0xFFFFFFFFLL), input.size() - inputAt);
+      HostIO::settle(machine, from, got);
+      const bool swap = (false == HostIO::littleEndian());
+      if ((false == swap) && (0U != got))
+       {
+         std::memcpy(static_cast<void*>(static_cast<unsigned char*>(static_cast<void*>(machine.memory)) + from),
+            static_cast<const void*>(&input[inputAt]), got);
+       }
+      for (size_t i = from; (true == swap) && (i < from + got); ++i)
+       {
+         MEM_T& word = machine.memory[i / sizeof(MEM_T)];
+         const unsigned int shift = 8U * (i % sizeof(MEM_T));
+         word = (word & ~(0xFFU << shift)) | (static_cast<MEM_T>(input[inputAt + i - from]) << shift);
+       }
+      machine.invalidateBytes(from, got);
+      inputAt += got;
+      return static_cast<BELT_T>(got);
+    }
+ };
+
+// Offset of the first byte from at which a and b differ, or count if they don't.
+static size_t mismatchScalar(const unsigned char * a, const unsigned char * b, size_t from, size_t count)
+ {
+   while ((from < count) && (a[from] == b[from]))
+    {
+      ++from;
+    }
+   return from;
+ }
+
+// Offset of the first byte from at which value is, or count if it isn't there.
+static size_t findScalar(const unsigned char * bytes, unsigned char value, size_t from, size_t count)
+ {
+   while ((from < count) && (value != bytes[from]))
+    {
+      ++from;
+    }
+   return from;
+ }
+
+#ifdef MILL_SIMD
+static size_t mismatchSSE2(const unsigned char * a, const unsigned char * b, size_t count)
+ {
+   size_t i = 0U;
+   for (; i + 16U <= count; i += 16U)
+    {
+      const __m128i same = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+         _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+      const unsigned int differ = 0xFFFFU ^ static_cast<unsigned int>(_mm_movemask_epi8(same));
+      if (0U != differ)
+       {
+         return i + static_cast<size_t>(__builtin_ctz(differ));
+       }
+    }
+   return mismatchScalar(a, b, i, count);
+ }
+
+__attribute__((target("avx2"))) static size_t mismatchAVX2(const unsigned char * a, const unsigned char * b, size_t count)
+ {
+   size_t i = 0U;
+   for (; i + 32U <= count; i += 32U)
+    {
+      const __m256i same = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+      const unsigned int differ = ~static_cast<unsigned int>(_mm256_movemask_epi8(same));
+      if (0U != differ)
+       {
+         return i + static_cast<size_t>(__builtin_ctz(differ));
+       }
+    }
+   return mismatchScalar(a, b, i, count);
+ }
+
+static size_t findSSE2(const unsigned char * bytes, unsigned char value, size_t count)
+ {
+   const __m128i wanted = _mm_set1_epi8(static_cast<char>(value));
+   size_t i = 0U;
+   for (; i + 16U <= count; i += 16U)
+    {
+      const unsigned int hit = static_cast<unsigned int>(_mm_movemask_epi8(
+         _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i)), wanted)));
+      if (0U != hit)
+       {
+         return i + static_cast<size_t>(__builtin_ctz(hit));
+       }
+    }
+   return findScalar(bytes, value, i, count);
+ }
+
+__attribute__((target("avx2"))) static size_t findAVX2(const unsigned char * bytes, unsigned char value, size_t count)
+ {
+   const __m256i wanted = _mm256_set1_epi8(static_cast<char>(value));
+   size_t i = 0U;
+   for (; i + 32U <= count; i += 32U)
+    {
+      const unsigned int hit = static_cast<unsigned int>(_mm256_movemask_epi8(
+         _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i)), wanted)));
+      if (0U != hit)
+       {
+         return i + static_cast<size_t>(__builtin_ctz(hit));
+       }
+    }
+   return findScalar(bytes, value, i, count);
+ }
+
+static bool hostHasAVX2()
+ {
+   static const bool has = (0 != __builtin_cpu_supports("avx2"));
+   return has;
+ }
+#endif
+
+static size_t mismatchBytes(const unsigned char * a, const unsigned char * b, size_t count)
+ {
+#ifdef MILL_SIMD
+   return (true == hostHasAVX2()) ? mismatchAVX2(a, b, count) : mismatchSSE2(a, b, count);
+#else
+   return mismatchScalar(a, b, 0U, count);
+#endif
+ }
+
+static size_t findByte(const unsigned char * bytes, unsigned char value, size_t count)
+ {
+#ifdef MILL_SIMD
+   return (true == hostHasAVX2()) ? findAVX2(bytes, value, count) : findSSE2(bytes, value, count);
+#else
+   return findScalar(bytes, value, 0U, count);
+#endif
+ }
+
+// The packed ALU operations, opcodes 16 to 21, in order. Each treats a word as four byte lanes, or two half lanes,
+// as the mode in its condition field says.
+static const unsigned int PACKED_ADD = 0U;
+static const unsigned int PACKED_SUB = 1U;
+static const unsigned int PACKED_CMP = 2U;
+static const unsigned int PACKED_MIN = 3U;
+static const unsigned int PACKED_MAX = 4U;
+static const unsigned int PACKED_SHUF = 5U;
+static const unsigned int PACKED_HALVES = 0x1U; // Two 16 bit lanes rather than four bytes
+static const unsigned int PACKED_SIGNED = 0x2U; // Lanes are signed (saturation, ordering, MIN and MAX)
+static const unsigned int PACKED_SATURATE = 0x4U; // ADD and SUB saturate; CMP is greater-than rather than equality
+static const unsigned int PACKED_RESERVED = 0x8U;
+
+// A lane at a time. Sets OVERFLOW when any lane saturated.
+static BELT_T packedScalar(unsigned int op, unsigned int mode, unsigned int lhs, unsigned int rhs)
+ {
+   unsigned int result = 0U;
+   if (PACKED_SHUF == op) // Each byte of rhs picks a byte of lhs, or zero with its top bit set
+    {
+      for (unsigned int lane = 0U; lane < 32U; lane += 8U)
+       {
+         const unsigned int select = (rhs >> lane) & 0xFFU;
+         if (0U == (select & 0x80U))
+          {
+            result |= ((lhs >> ((select & 3U) * 8U)) & 0xFFU) << lane;
+          }
+       }
+      return result;
+    }
+   const unsigned int bits = (0U != (mode & PACKED_HALVES)) ? 16U : 8U;
+   const int mask = (1 << bits) - 1;
+   const int top = 1 << (bits - 1U);
+   const bool sign = (0U != (mode & PACKED_SIGNED));
+   const bool saturate = (0U != (mode & PACKED_SATURATE));
+   const int low = (true == sign) ? -top : 0;
+   const int high = (true == sign) ? (top - 1) : mask;
+   BELT_T flags = 0U;
+   for (unsigned int lane = 0U; lane < 32U; lane += bits)
+    {
+      int x = static_cast<int>(lhs >> lane) & mask;
+      int y = static_cast<int>(rhs >> lane) & mask;
+      if (true == sign)
+       {
+         x = (x ^ top) - top;
+         y = (y ^ top) - top;
+       }
+      int r;
+      switch (op)
+       {
+         case PACKED_ADD: r = x + y; break;
+         case PACKED_SUB: r = x - y; break;
+         case PACKED_CMP: r = ((true == saturate) ? (x > y) : (x == y)) ? mask : 0; break;
+         case PACKED_MIN: r = (x < y) ? x : y; break;
+         default: r = (x > y) ? x : y; break;
+       }
+      if ((true == saturate) && (op <= PACKED_SUB) && ((r < low) || (r > high)))
+       {
+         r = (r < low) ? low : high;
+         flags = OVERFLOW;
+       }
+      result |= static_cast<unsigned int>(r & mask) << lane;
+    }
+   return result | flags;
+ }
+
+#ifdef MILL_SIMD
+// The word goes in the low lanes of an SSE2 register. SSE2 has each lane width of the saturating ADD and SUB, but
+// only one order of MIN, MAX and greater-than for each: flipping the top bit of each lane trades one order for the other.
+class PackedBytes
+ {
+public:
+   static const bool SIGNED_ORDER = false; // Of MIN and MAX
+   static __m128i bias() { return _mm_set1_epi8(static_cast<char>(0x80)); }
+   static __m128i add(__m128i x, __m128i y) { return _mm_add_epi8(x, y); }
+   static __m128i sub(__m128i x, __m128i y) { return _mm_sub_epi8(x, y); }
+   static __m128i adds(__m128i x, __m128i y, bool sign) { return sign ? _mm_adds_epi8(x, y) : _mm_adds_epu8(x, y); }
+   static __m128i subs(__m128i x, __m128i y, bool sign) { return sign ? _mm_subs_epi8(x, y) : _mm_subs_epu8(x, y); }
+   static __m128i cmpeq(__m128i x, __m128i y) { return _mm_cmpeq_epi8(x, y); }
+   static __m128i cmpgt(__m128i x, __m128i y) { return _mm_cmpgt_epi8(x, y); } // Signed
+   static __m128i min(__m128i x, __m128i y) { return _mm_min_epu8(x, y); }
+   static __m128i max(__m128i x, __m128i y) { return _mm_max_epu8(x, y); }
+ };
+
+class PackedHalves
+ {
+public:
+   static const bool SIGNED_ORDER = true;
+   static __m128i bias() { return _mm_set1_epi16(static_cast<short>(0x8000)); }
+   static __m128i add(__m128i x, __m128i y) { return _mm_add_epi16(x, y); }
+   static __m128i sub(__m128i x, __m128i y) { return _mm_sub_epi16(x, y); }
+   static __m128i adds(__m128i x, __m128i y, bool sign) { return sign ? _mm_adds_epi16(x, y) : _mm_adds_epu16(x, y); }
+   static __m128i subs(__m128i x, __m128i y, bool sign) { return sign ? _mm_subs_epi16(x, y) : _mm_subs_epu16(x, y); }
+   static __m128i cmpeq(__m128i x, __m128i y) { return _mm_cmpeq_epi16(x, y); }
+   static __m128i cmpgt(__m128i x, __m128i y) { return _mm_cmpgt_epi16(x, y); }
+   static __m128i min(__m128i x, __m128i y) { return _mm_min_epi16(x, y); }
+   static __m128i max(__m128i x, __m128i y) { return _mm_max_epi16(x, y); }
+ };
+
+template <class LANES>
+static BELT_T packedSSE2(unsigned int op, unsigned int mode, unsigned int lhs, unsigned int rhs)
+ {
+   const __m128i x = _mm_cvtsi32_si128(static_cast<int>(lhs));
+   const __m128i y = _mm_cvtsi32_si128(static_cast<int>(rhs));
+   const bool sign = (0U != (mode & PACKED_SIGNED));
+   const bool saturate = (0U != (mode & PACKED_SATURATE));
+   const __m128i bias = (sign == LANES::SIGNED_ORDER) ? _mm_setzero_si128() : LANES::bias();
+   __m128i r;
+   switch (op)
+    {
+      case PACKED_ADD:
+      case PACKED_SUB:
+         r = (PACKED_ADD == op) ? LANES::add(x, y) : LANES::sub(x, y);
+         if (true == saturate)
+          {
+            const __m128i s = (PACKED_ADD == op) ? LANES::adds(x, y, sign) : LANES::subs(x, y, sign);
+            const unsigned int result = static_cast<unsigned int>(_mm_cvtsi128_si32(s));
+            return (result != static_cast<unsigned int>(_mm_cvtsi128_si32(r))) ? (result | OVERFLOW) : result;
+          }
+         break;
+      case PACKED_CMP: // Greater-than is signed for both widths
+         r = (false == saturate) ? LANES::cmpeq(x, y) : ((true == sign) ? LANES::cmpgt(x, y) :
+            LANES::cmpgt(_mm_xor_si128(x, LANES::bias()), _mm_xor_si128(y, LANES::bias())));
+         break;
+      case PACKED_MIN:
+         r = _mm_xor_si128(LANES::min(_mm_xor_si128(x, bias), _mm_xor_si128(y, bias)), bias);
+         break;
+      default:
+         r = _mm_xor_si128(LANES::max(_mm_xor_si128(x, bias), _mm_xor_si128(y, bias)), bias);
+         break;
+    }
+   return static_cast<unsigned int>(_mm_cvtsi128_si32(r));
+ }
+#endif
+
+// SSE2 has no byte shuffle (PSHUFB is SSSE3), and four bytes are as quickly picked out one at a time.
+// Kept out of line, so that it doesn't crowd the ALU's other handlers.
+__attribute__((noinline)) static BELT_T packedOp(unsigned int op, unsigned int mode, unsigned int lhs, unsigned int rhs)
+ {
+#ifdef MILL_SIMD
+   if (PACKED_SHUF != op)
+    {
+      return (0U != (mode & PACKED_HALVES)) ? packedSSE2<PackedHalves>(op, mode, lhs, rhs) :
+         packedSSE2<PackedBytes>(op, mode, lhs, rhs);
+    }
+#endif
+   return packedScalar(op, mode, lhs, rhs);
+ }
+
+// The memory interrupts: copy, fill, compare and scan ranges of bytes, numbered as ldb and stb number them.
+// On a little-endian host that is the layout of memory, so they are done by the host's library and the kernels
+// above; elsewhere they go a byte at a time.
+class BulkMemory
+ {
+public:
+   static unsigned char * bytes(Machine& machine)
+    {
+      return static_cast<unsigned char*>(static_cast<void*>(machine.memory));
+    }
+
+   static unsigned char byteAt(const Machine& machine, size_t at)
+    {
+      return static_cast<unsigned char>((machine.memory[at / sizeof(MEM_T)] >> (8U * (at % sizeof(MEM_T)))) & 0xFFU);
+    }
+
+   static void setByte(Machine& machine, size_t at, unsigned char value)
+    {
+      MEM_T& word = machine.memory[at / sizeof(MEM_T)];
+      const unsigned int shift = 8U * (at % sizeof(MEM_T));
+      word = (word & ~(0xFFU << shift)) | (static_cast<MEM_T>(value) << shift);
+    }
+
+   static bool definite(BELT_T value)
+    {
+      return 0U == (value & (INVALID | TRANSIENT));
+    }
+
+   // Returns length, or INVALID.
+   static BELT_T copy(Machine& machine, BELT_T to, BELT_T from, BELT_T length)
+    {
+      if ((false == HostIO::inside(machine, to, length)) || (false == HostIO::inside(machine, from, length)))
+       {
+         return INVALID;
+       }
+      const size_t dest = static_cast<size_t>(to & 0xFFFFFFFFLL);
+      const size_t src = static_cast<size_t>(from & 0xFFFFFFFFLL);
+      const size_t count = static_cast<size_t>(length & 0xFFFFFFFFLL);
+      HostIO::settle(machine, src, count);
+      HostIO::settle(machine, dest, count);
+      if (true == HostIO::littleEndian())
+       {
+         std::memmove(static_cast<void*>(bytes(machine) + dest), static_cast<const void*>(bytes(machine) + src), count);
+       }
+      else if (dest < src) // As memmove: an overlap is read before it is written.
+       {
+         for (size_t i = 0U; i < count; ++i)
+          {
+            setByte(machine, dest + i, byteAt(machine, src + i));
+          }
+       }
+      else
+       {
+         for (size_t i = count; i > 0U; --i)
+          {
+            setByte(machine, dest + i - 1U, byteAt(machine, src + i - 1U));
+          }
+       }
+      machine.invalidateBytes(dest, count);
+      return static_cast<BELT_T>(count);
+    }
+
+   // Returns length, or INVALID.
+   static BELT_T fill(Machine& machine, BELT_T to, BELT_T value, BELT_T length)
+    {
+      if ((false == HostIO::inside(machine, to, length)) || (false == definite(value)))
+       {
+         return INVALID;
+       }
+      const size_t dest = static_cast<size_t>(to & 0xFFFFFFFFLL);
+      const size_t count = static_cast<size_t>(length & 0xFFFFFFFFLL);
+      HostIO::settle(machine, dest, count);
+      if (true == HostIO::littleEndian())
+       {
+         std::memset(static_cast<void*>(bytes(machine) + dest), static_cast<int>(value & 0xFF), count);
+       }
+      else
+       {
+         for (size_t i = 0U; i < count; ++i)
+          {
+            setByte(machine, dest + i, static_cast<unsigned char>(value & 0xFF));
+          }
+       }
+      machine.invalidateBytes(dest, count);
+      return static_cast<BELT_T>(count);
+    }
+
+   // Returns the offset of the first byte at which the ranges differ, length if they don't, or INVALID.
+   static BELT_T compare(Machine& machine, BELT_T left, BELT_T right, BELT_T length)
+    {
+      if ((false == HostIO::inside(machine, left, length)) || (false == HostIO::inside(machine, right, length)))
+       {
+         return INVALID;
+       }
+      const size_t a = static_cast<size_t>(left & 0xFFFFFFFFLL);
+      const size_t b = static_cast<size_t>(right & 0xFFFFFFFFLL);
+      const size_t count = static_cast<size_t>(length & 0xFFFFFFFFLL);
+      HostIO::settle(machine, a, count);
+      HostIO::settle(machine, b, count);
+      if (true == HostIO::littleEndian())
+       {
+         return static_cast<BELT_T>(mismatchBytes(bytes(machine) + a, bytes(machine) + b, count));
+       }
+      size_t i = 0U;
+      while ((i < count) && (byteAt(machine, a + i) == byteAt(machine, b + i)))
+       {
+         ++i;
+       }
+      return static_cast<BELT_T>(i);
+    }
+
+   // Returns the offset of the first byte that is value, length if there isn't one, or INVALID.
+   static BELT_T scan(Machine& machine, BELT_T from, BELT_T value, BELT_T length)
+    {
+      if ((false == HostIO::inside(machine, from, length)) || (false == definite(value)))
+       {
+         return INVALID;
+       }
+      const size_t at = static_cast<size_t>(from & 0xFFFFFFFFLL);
+      const size_t count = static_cast<size_t>(length & 0xFFFFFFFFLL);
+      const unsigned char wanted = static_cast<unsigned char>(value & 0xFF);
+      HostIO::settle(machine, at, count);
+      if (true == HostIO::littleEndian())
+       {
+         return static_cast<BELT_T>(findByte(bytes(machine) + at, wanted, count));
+       }
+      size_t i = 0U;
+      while ((i < count) && (wanted != byteAt(machine, at + i)))
+       {
+         ++i;
+       }
+      return static_cast<BELT_T>(i);
+    }
+ };
+
+static inline void cpuRelax()
+ {
+#if defined(__i386__) || defined(__x86_64__)
+   __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+   __asm__ __volatile__ ("yield");
+#endif
+ }
+
+// Keep the hot words of a barrier on their own cache lines, so that the arrival
+// counter isn't bouncing the line the waiters are spinning on.
+static const size_t CACHE_LINE = 64U;
+
+enum SyncKind
+ {
+   SYNC_PTHREAD,
+   SYNC_SPIN,
+   SYNC_HYBRID
+ };
+
+// What the units and the core use to meet at the start and end of a clock cycle.
+class Synchronizer
+ {
+public:
+   virtual ~Synchronizer() { }
+   virtual void wait() = 0;
+
+   static Synchronizer* create(SyncKind kind, size_t parties);
+   static const char* name(SyncKind kind)
+    {
+      return (SYNC_SPIN == kind) ? "spin" : ((SYNC_HYBRID == kind) ? "hybrid" : "pthread");
+    }
+ };
+
+class PthreadSynchronizer : public Synchronizer
+ {
+public:
+   pthread_barrier_t barrier;
+
+   PthreadSynchronizer(size_t parties)
+    {
+      pthread_barrier_init(&barrier, NULL, parties);
+    }
+
+   virtual ~PthreadSynchronizer()
+    {
+      pthread_barrier_destroy(&barrier);
+    }
+
+   virtual void wait()
+    {
+      pthread_barrier_wait(&barrier);
+    }
+ };
+
+// A sense-reversing barrier. The last thread to arrive resets the count and flips the sense,
+// which releases everyone spinning on it. A thread samples the sense before it arrives:
+// the sense cannot flip until that thread has arrived, so no thread-local sense is needed.
+class SpinSynchronizer : public Synchronizer
+ {
+public:
+   char pad0 [CACHE_LINE];
+   std::atomic<size_t> count;
+   char pad1 [CACHE_LINE - sizeof(std::atomic<size_t>)];
+   std::atomic<int> sense;
+   char pad2 [CACHE_LINE - sizeof(std::atomic<int>)];
+   const size_t parties;
+
+   SpinSynchronizer(size_t parties) : count(parties), sense(0), parties(parties) { }
+
+   // Returns true if this thread was the last to arrive (and has released the others).
+   bool arrive(int& mySense)
+    {
+      mySense = sense.load(std::memory_order_acquire);
+      if (1U == count.fetch_sub(1U, std::memory_order_acq_rel))
+       {
+         count.store(parties, std::memory_order_relaxed);
+         sense.store(mySense ^ 1, std::memory_order_release);
+         return true;
+       }
+      return false;
+    }
+
+   virtual void wait()
+    {
+      int mySense;
+      if (false == arrive(mySense))
+       {
+         for (size_t spins = 1U; mySense == sense.load(std::memory_order_acquire); ++spins)
+          {
+            cpuRelax();
+            if (0U == (spins & 0x3FF)) // Don't starve the thread we're waiting on when the host is oversubscribed.
+             {
+               sched_yield();
+             }
+          }
+       }
+    }
+ };
+
+// Spin for a while, as most cycles are short, and then go to sleep in the kernel.
+// Off of Linux there is no futex, so the sleep degrades to yielding.
+class HybridSynchronizer : public SpinSynchronizer
+ {
+public:
+   std::atomic<int> sleepers;
+   size_t spinLimit;
+
+   // With one processor, the thread we'd be spinning on can't run until we give up ours.
+   HybridSynchronizer(size_t parties) : SpinSynchronizer(parties), sleepers(0),
+      spinLimit((1L < sysconf(_SC_NPROCESSORS_ONLN)) ? 2000U : 0U) { }
+
+   virtual void wait()
+    {
+      int mySense;
+      if (true == arrive(mySense))
+       {
+         // arrive() flips the sense with a release store, which the load of sleepers could pass,
+         // missing a waiter that counted itself in and then saw the old sense.
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         if (0 != sleepers.load(std::memory_order_seq_cst))
+          {
+#ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<int*>(&sense), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+          }
+         return;
+       }
+      for (size_t spins = 0U; spins < spinLimit; ++spins)
+       {
+         if (mySense != sense.load(std::memory_order_acquire))
+          {
+            return;
+          }
+         cpuRelax();
+       }
+      sleepers.fetch_add(1, std::memory_order_seq_cst);
+      while (mySense == sense.load(std::memory_order_seq_cst))
+       {
+#ifdef __linux__
+         // The kernel rechecks the sense before sleeping, so a flip between the load and here isn't lost.
+         syscall(SYS_futex, reinterpret_cast<int*>(&sense), FUTEX_WAIT_PRIVATE, mySense, NULL, NULL, 0);
+#else
+         sched_yield();
+#endif
+       }
+      sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+ };
+
+Synchronizer* Synchronizer::create(SyncKind kind, size_t parties)
+ {
+   switch (kind)
+    {
+      case SYNC_SPIN:
+         return new SpinSynchronizer(parties);
+      case SYNC_HYBRID:
+         return new HybridSynchronizer(parties);
+      default:
+         return new PthreadSynchronizer(parties);
+    }
+ }
+
+class FunctionalUnit
+ {
+public:
+   Machine* machine;
+   Synchronizer* synchronizer;
+   size_t slot;
+   pthread_t thread;
+
+   virtual void doStuff() = 0;
+   virtual void step() = 0;
+
+   BELT_T getMemory(size_t location)
+    {
+      if (location >= machine->memsize)
+       {
+         return INVALID;
+       }
+      return machine->memory[location];
+    }
+
+   BELT_T setMemory(size_t location, MEM_T value)
+    {
+      if (location >= machine->memsize)
+       {
+         return INVALID;
+       }
+      machine->memory[location] = value;
+      machine->invalidate(location);
+      return 0U;
+    }
+
+   // Returns NULL for a location outside of memory.
+   const ALUDecoded* fetchALU(size_t location)
+    {
+      if (location >= machine->memsize)
+       {
+         return NULL;
+       }
+      ALUDecoded& result = machine->aluDecoded[location];
+      if (UNDECODED == result.code)
+       {
+         result.decode(machine->memory[location]);
+       }
+      return &result;
+    }
+
+   const FlowDecoded* fetchFlow(size_t location)
+    {
+      if (location >= machine->memsize)
+       {
+         return NULL;
+       }
+      FlowDecoded& result = machine->flowDecoded[location];
+      if (UNDECODED == result.code)
+       {
+         result.decode(machine->memory[location]);
+       }
+      return &result;
+    }
+
+   // The top two positions of each belt name constants: no need to look for them.
+   static BELT_T beltConstant(size_t beltLocation)
+    {
+      static const BELT_T constants [4] = { ZERO, 1, INVALID, TRANSIENT };
+      return constants[((beltLocation >> 4) & 2) | (beltLocation & 1)];
+    }
+
+   // Every operand goes through here: with an engine for each width, GCC stops inlining it unless told to.
+   __attribute__((always_inline)) static BELT_T getBeltContent(Frame& frame, size_t beltLocation)
+    {
+      if (OPERAND_CONSTANTS <= (beltLocation & OPERAND_POSITION))
+       {
+         return beltConstant(beltLocation);
+       }
+      if (0U == (beltLocation & OPERAND_SLOW))
+       {
+         if (beltLocation >= frame.fsize)
+          {
+            return INVALID;
+          }
+         return frame.fast.get((frame.ffront + beltLocation) & BELT_MASK);
+       }
+      else
+       {
+         if ((beltLocation & OPERAND_POSITION) >= frame.ssize)
+          {
+            return INVALID;
+          }
+         return frame.slow.get((frame.sfront + beltLocation) & BELT_MASK);
+       }
+    }
+
+   static bool extraNumerical(BELT_T op, BELT_T& res)
+    {
+      if (0L != (op & (TRANSIENT | INVALID)))
+       {
+         res = op;
+         return true;
+       }
+      return false;
+    }
+
+   static bool extraNumerical(BELT_T op1, BELT_T op2, BELT_T& res)
+    {
+      if (0L != ((op1 & op2) & TRANSIENT))
+       {
+         res = op1 > op2 ? op1 : op2; // Assume that the flow address of highest value is
+         return true; // the chronologically earlier instruction
+       }
+      if (0L != (op1 & TRANSIENT)) // TRANSIENT takes precedence over INVALID
+       {
+         res = op1;
+         return true;
+       }
+      if (0L != (op2 & TRANSIENT))
+       {
+         res = op2;
+         return true;
+       }
+      if (0L != ((op1 & op2) & INVALID))
+       {
+         res = op1 > op2 ? op1 : op2;
+         return true;
+       }
+      if (0L != (op1 & INVALID)) // Save the metadata for INVALID
+       {
+         res = op1;
+         return true;
+       }
+      if (0L != (op2 & INVALID))
+       {
+         res = op2;
+         return true;
+       }
+      return false;
+    }
+
+   static bool extraNumerical(BELT_T op1, BELT_T op2, BELT_T op3, BELT_T& res)
+    {
+      BELT_T temp = TRANSIENT;
+      bool result = false;
+      if (0L != (op1 & TRANSIENT))
+       {
+         temp = temp > op1 ? temp : op1;
+         result = true;
+       }
+      if (0L != (op2 & TRANSIENT))
+       {
+         temp = temp > op2 ? temp : op2;
+         result = true;
+       }
+      if (0L != (op3 & TRANSIENT))
+       {
+         temp = temp > op3 ? temp : op3;
+         result = true;
+       }
+      if (true == result)
+       {
+         res = temp;
+         return true;
+       }
+      temp = INVALID;
+      if (0L != (op1 & INVALID))
+       {
+         temp = temp > op1 ? temp : op1;
+         result = true;
+       }
+      if (0L != (op2 & INVALID))
+       {
+         temp = temp > op2 ? temp : op2;
+         result = true;
+       }
+      if (0L != (op3 & INVALID))
+       {
+         temp = temp > op3 ? temp : op3;
+         result = true;
+       }
+      if (true == result)
+       {
+         res = temp;
+       }
+      return result;
+    }
+
+   static BELT_T getZero(BELT_T input)
+    {
+      if (0U == (input & 0xFFFFFFFF))
+       {
+         return ZERO;
+       }
+      return 0;
+    }
+
+   static BELT_T getAdd(BELT_T op1, BELT_T op2, BELT_T op3)
+    {
+      BELT_T cb = (op3 & CARRY) ? 1 : 0;
+      BELT_T result = (op1 + op2 + cb) & 0x1FFFFFFFFLL; // CARRY/BORROW is free
+      if (0U != ((result ^ op1) & (result ^ op2) & 0x80000000))
+       {
+         result |= OVERFLOW;
+       }
+      return result;
+    }
+
+   bool conditionTrue(BELT_T cond, BELT_T flags)
+    {
+      if (0U != (cond & ~0xFLL))
+       {
+         std::printf("Arrived in conditionTrue with invalid condition code.\nThis is a bug.\n");
+         machine->invalidOp = true;
+         return false;
+       }
+      static const BELT_T conds [] = { 0U, CARRY, OVERFLOW, NEGATIVE, ZERO, ZERO | NEGATIVE, INVALID, TRANSIENT };
+      if (0 == cond)
+       {
+         return true;
+       }
+      else if (1 == cond)
+       {
+         return (0U == (flags & (INVALID | TRANSIENT)));
+       }
+      else
+       {
+         if (0U == (cond & 1))
+          {
+            return (0U != (flags & conds[cond >> 1]));
+          }
+         else
+          {
+            return (0U == (flags & conds[cond >> 1]));
+          }
+       }
+    }
+ };
+
+class ALUnit : public FunctionalUnit
+ {
+public:
+   virtual void doStuff()
+    {
+      for (;;)
+       {
+         //Wait for the start of an instruction cycle
+         synchronizer->wait();
+         // Do we need to die?
+         if (true == machine->terminate)
+          {
+//            std::printf("Terminating ALU slot: %lu\n", slot);
+            break;
+          }
+         step();
+         // Signal that we have ended this cycle.
+         synchronizer->wait();
+       }
+    }
+
+   // The three operand and immediate arithmetic ops share everything but the computation.
+   // Fetch their operands, and deal with a false condition or a non-numeric operand.
+   // Returns true if that settled the result, and there is nothing left to compute.
+   bool arithmetic(Frame& frame, const ALUDecoded& ins, BELT_T* dest, BELT_T& op1, BELT_T& op2)
+    {
+      BELT_T temp;
+      op1 = getBeltContent(frame, ins.a);
+      if (0 == (ins.code & 0x10))
+       {
+         op2 = getBeltContent(frame, ins.b);
+         if (false == conditionTrue(ins.cond, getBeltContent(frame, ins.src)))
+          {
+            dest[0] = TRANSIENT | frame.alupc;
+            if ((9 == (ins.code & 0xF)) || (10 == (ins.code & 0xF)))
+             {
+               dest[1] = TRANSIENT | frame.alupc;
+             }
+            return true;
+          }
+       }
+      else
+       {
+         op2 = ins.imm; // Unconditional
+       }
+      if (true == extraNumerical(op1, op2, temp))
+       {
+         dest[0] = temp;
+         if ((9 == (ins.code & 0xF)) || (10 == (ins.code & 0xF)))
+          {
+            dest[1] = temp;
+          }
+         return true;
+       }
+      return false;
+    }
+
+   // Interpret and execute the next operation.
+   virtual void step()
+    {
+      Frame& frame = machine->frames.back();
+      ALURetire& retire = machine->alu_retire[slot];
+      retire.flush(); // Make retire station is clean.
+      if (0U != frame.alunop)
+       {
+#ifdef MILL_STATS
+         ++machine->counters.alu[slot][SLOT_ELIDED];
+#endif
+         return;
+       }
+//      std::printf("Executing ALU slot: %lu %lu\n", slot, frame.alupc);
+      static const ALUDecoded outside (0U); // A fetch from outside of memory executes as a NOP
+      const ALUDecoded* ins = fetchALU(frame.alupc + slot);
+      if (NULL == ins)
+       {
+         std::printf("Terminate initiated due to invalid operation in ALU slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.alupc + slot));
+         machine->invalidOp = true;
+         ins = &outside;
+       }
+      execute(frame, retire, ins);
+    }
+
+   void execute(Frame& frame, ALURetire& retire, const ALUDecoded* ins)
+    {
+      BELT_T* const dests [2] = { retire.fast, retire.slow };
+      BELT_T* dest = dests[ins->slow];
+      BELT_T op1, op2, op3, temp;
+      retire.nops = ins->nops;
+#ifdef MILL_STATS
+      ++machine->counters.alu[slot][(0U == ins->code) ? SLOT_NOP : SLOT_OP];
+#endif
+
+#ifdef MILL_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+      static void* const handlers [32] =
+       {
+         &&ALU_NOP, &&ALU_ADDC, &&ALU_SUBB, &&ALU_MULL, &&ALU_DIVL, &&ALU_PICK, &&ALU_ADD, &&ALU_SUB,
+         &&ALU_MUL, &&ALU_DIV, &&ALU_UDIV, &&ALU_SHR, &&ALU_ASHR, &&ALU_AND, &&ALU_OR, &&ALU_XOR,
+         &&ALU_PACKED, &&ALU_PACKED, &&ALU_PACKED, &&ALU_PACKED, &&ALU_PACKED, &&ALU_PACKED, &&ALU_ADD, &&ALU_SUB,
+         &&ALU_MUL, &&ALU_DIV, &&ALU_UDIV, &&ALU_SHR, &&ALU_ASHR, &&ALU_AND, &&ALU_OR, &&ALU_XOR
+       };
+      goto *handlers[ins->code];
+#pragma GCC diagnostic pop
+#else
+      switch (ins->code)
+       {
+         case 0: goto ALU_NOP;
+         case 1: goto ALU_ADDC;
+         case 2: goto ALU_SUBB;
+         case 3: goto ALU_MULL;
+         case 4: goto ALU_DIVL;
+         case 5: goto ALU_PICK;
+         case 6: case 22: goto ALU_ADD;
+         case 7: case 23: goto ALU_SUB;
+         case 8: case 24: goto ALU_MUL;
+         case 9: case 25: goto ALU_DIV;
+         case 10: case 26: goto ALU_UDIV;
+         case 11: case 27: goto ALU_SHR;
+         case 12: case 28: goto ALU_ASHR;
+         case 13: case 29: goto ALU_AND;
+         case 14: case 30: goto ALU_OR;
+         case 15: case 31: goto ALU_XOR;
+         case 16: case 17: case 18: case 19: case 20: case 21: goto ALU_PACKED;
+         default: goto ALU_INVALID;
+       }
+#endif
+
+ALU_NOP:
+      return;
+
+ALU_ADDC:
+      op1 = getBeltContent(frame, ins->a);
+      op2 = getBeltContent(frame, ins->b);
+      op3 = getBeltContent(frame, ins->c);
+      if (false == extraNumerical(op1, op2, temp))
+       {
+         temp = getAdd(op1 & 0xFFFFFFFFLL, op2 & 0xFFFFFFFFLL, op3);
+         temp |= getZero(temp);
+       }
+      dest[0] = temp;
+      return;
+
+ALU_SUBB:
+      op1 = getBeltContent(frame, ins->a);
+      op2 = getBeltContent(frame, ins->b);
+      op3 = getBeltContent(frame, ins->c);
+      if (false == extraNumerical(op1, op2, temp))
+       {
+         temp = getAdd(op1 & 0xFFFFFFFFLL, (op2 & 0xFFFFFFFFLL) ^ 0xFFFFFFFFLL, op3 ^ CARRY) ^ CARRY;
+         temp |= getZero(temp);
+       }
+      dest[0] = temp;
+      return;
+
+ALU_MULL:
+      op1 = getBeltContent(frame, ins->a);
+      op2 = getBeltContent(frame, ins->b);
+      if (true == extraNumerical(op1, op2, temp))
+       {
+         dest[0] = temp;
+         dest[1] = temp;
+       }
+      else
+       {
+         temp = (op1 & 0xFFFFFFFFLL) * (op2 & 0xFFFFFFFFLL);
+         BELT_T temp1 = temp & 0xFFFFFFFFLL;
+         BELT_T temp2 = (temp >> 32) & 0xFFFFFFFFLL;
+         temp1 |= getZero(temp1);
+         temp2 |= getZero(temp2);
+         dest[0] = temp1;
+         dest[1] = temp2;
+       }
+      return;
+
+ALU_DIVL:
+      op1 = getBeltContent(frame, ins->a);
+      op2 = getBeltContent(frame, ins->b);
+      op3 = getBeltContent(frame, ins->c);
+      if (true == extraNumerical(op1, op2, op3, temp))
+       {
+         dest[0] = temp;
+         dest[1] = temp;
+       }
+      else
+       {
+         if (0U == (op3 & 0xFFFFFFFFLL))
+          {
+            temp = INVALID | frame.alupc;
+            dest[0] = temp;
+            dest[1] = temp;
+          }
+         else
+          {
+            temp = static_cast<unsigned long long>((op1 << 32) | (op2 & 0xFFFFFFFFLL)) / (op3 & 0xFFFFFFFFLL);
+            BELT_T temp2 = static_cast<unsigned long long>((op1 << 32) | (op2 & 0xFFFFFFFFLL)) % (op3 & 0xFFFFFFFFLL);
+            if (temp > 0xFFFFFFFFLL)
+             {
+               temp = (temp & 0xFFFFFFFFLL) | OVERFLOW;
+             }
+            temp |= getZero(temp);
+            temp2 |= getZero(temp2);
+            dest[0] = temp;
+            dest[1] = temp2;
+          }
+       }
+      return;
+
+ALU_PICK:
+      op1 = getBeltContent(frame, ins->a);
+      if (conditionTrue(ins->cond, op1))
+       {
+         dest[0] = getBeltContent(frame, ins->b);
+       }
+      else
+       {
+         dest[0] = getBeltContent(frame, ins->c);
+       }
+      return;
+
+ALU_ADD:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      temp = getAdd(op1 & 0xFFFFFFFFLL, op2 & 0xFFFFFFFFLL, 0U);
+      goto ALU_RESULT;
+
+ALU_SUB:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      temp = getAdd(op1 & 0xFFFFFFFFLL, (op2 & 0xFFFFFFFFLL) ^ 0xFFFFFFFFLL, CARRY) ^ CARRY;
+      goto ALU_RESULT;
+
+ALU_MUL:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      temp = (op1 & 0xFFFFFFFFLL) * (op2 & 0xFFFFFFFFLL);
+      if (0U != ((op1 ^ op2 ^ temp) & 0x80000000LL))
+       {
+         temp = (temp & 0xFFFFFFFFLL) | OVERFLOW;
+       }
+      else
+       {
+         temp &= 0xFFFFFFFFLL;
+       }
+      goto ALU_RESULT;
+
+ALU_DIV:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      if (0U == (op2 & 0xFFFFFFFFLL))
+       {
+         temp = INVALID | frame.alupc;
+         dest[1] = temp;
+       }
+      else
+       {
+         if (0U != (op1 & NEGATIVE))
+          {
+            op1 |= 0xFFFFFFFF00000000LL;
+          }
+         else
+          {
+            op1 &= 0xFFFFFFFFLL;
+          }
+         if (0U != (op2 & NEGATIVE))
+          {
+            op2 |= 0xFFFFFFFF00000000LL;
+          }
+         else
+          {
+            op2 &= 0xFFFFFFFFLL;
+          }
+         temp = (op1 / op2) & 0xFFFFFFFFLL;
+         BELT_T temp2 = (op1 % op2) & 0xFFFFFFFFLL;
+         temp2 |= getZero(temp2);
+         dest[1] = temp2;
+       }
+      goto ALU_RESULT;
+
+ALU_UDIV:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      if (0U == (op2 & 0xFFFFFFFFLL))
+       {
+         temp = INVALID | frame.alupc;
+         dest[1] = temp;
+       }
+      else
+       {
+         temp = ((op1 & 0xFFFFFFFFLL) / (op2 & 0xFFFFFFFFLL)) & 0xFFFFFFFFLL;
+         BELT_T temp2 = ((op1 & 0xFFFFFFFFLL) % (op2 & 0xFFFFFFFFLL)) & 0xFFFFFFFFLL;
+         temp2 |= getZero(temp2);
+         dest[1] = temp2;
+       }
+      goto ALU_RESULT;
+
+ALU_SHR:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      if (0U == (op2 & NEGATIVE)) // op2 is positive, so shift is right
+       {
+         if (0 != (op2 & 0x7FFFFFFFLL))
+          {
+            if (33U <= (op2 & 0x7FFFFFFFLL))
+             {
+               temp = 0U;
+             }
+            else
+             {
+               temp = ((op1 & 0xFFFFFFFFLL) >> ((op2 & 0xFFFFFFFFLL) - 1)) & 0xFFFFFFFFLL;
+               BELT_T out = temp & 1;
+               temp >>= 1;
+               if (1 == out)
+                {
+                  temp |= CARRY;
+                }
+             }
+          }
+         else
+          {
+            temp = op1 & 0xFFFFFFFFLL;
+          }
+       }
+      else
+       {
+         if (33U <= (-op2 & 0x7FFFFFFFLL))
+          {
+            temp = 0U;
+          }
+         else
+          {
+            temp = ((op1 & 0xFFFFFFFFLL) << (-op2 & 0xFFFFFFFFLL)) & 0x1FFFFFFFFLL;
+          }
+       }
+      goto ALU_RESULT;
+
+ALU_ASHR:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      if (0U == (op2 & NEGATIVE)) // op2 is positive, so shift is right
+       {
+         if (32U <= (op2 & 0x7FFFFFFFLL))
+          {
+            if (0U == (op1 & NEGATIVE))
+             {
+               temp = 0U;
+             }
+            else
+             {
+               temp = 0xFFFFFFFFLL;
+             }
+          }
+         else
+          {
+            if (0U != (op1 & NEGATIVE))
+             {
+               op1 |= 0xFFFFFFFF00000000LL;
+             }
+            else
+             {
+               op1 &= 0xFFFFFFFFLL;
+             }
+            temp = (op1 >> (op2 & 0xFFFFFFFFLL)) & 0xFFFFFFFFLL;
+          }
+       }
+      else // Standard shift left.
+       {
+         if (32U <= (-op2 & 0x7FFFFFFFLL))
+          {
+            temp = 0U;
+          }
+         else
+          {
+            temp = ((op1 & 0xFFFFFFFFLL) << (-op2 & 0xFFFFFFFFLL)) & 0xFFFFFFFFLL;
+          }
+       }
+      goto ALU_RESULT;
+
+ALU_AND:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      temp = (op1 & op2) & 0xFFFFFFFFLL;
+      goto ALU_RESULT;
+
+ALU_OR:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      temp = (op1 | op2) & 0xFFFFFFFFLL;
+      goto ALU_RESULT;
+
+ALU_XOR:
+      if (true == arithmetic(frame, *ins, dest, op1, op2))
+       {
+         return;
+       }
+      temp = (op1 ^ op2) & 0xFFFFFFFFLL;
+      goto ALU_RESULT;
+
+ALU_PACKED: // Unconditional: the condition field is the mode
+      if (0U != (ins->cond & PACKED_RESERVED))
+       {
+         goto ALU_INVALID;
+       }
+      op1 = getBeltContent(frame, ins->a);
+      op2 = getBeltContent(frame, ins->b);
+      if (true == extraNumerical(op1, op2, temp))
+       {
+         dest[0] = temp;
+         return;
+       }
+      temp = packedOp(ins->code - 16U, ins->cond, static_cast<unsigned int>(op1), static_cast<unsigned int>(op2));
+      goto ALU_RESULT;
+
+ALU_RESULT:
+      temp |= getZero(temp);
+      dest[0] = temp;
+      return;
+
+ALU_INVALID: // RAISE INVALID OPERATION
+      std::printf("Terminate initiated due to invalid operation in ALU slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.alupc + slot));
+      machine->invalidOp = true;
+    }
+ };
+
+class FlowUnit : public FunctionalUnit
+ {
+public:
+
+   void fillBelt(Frame& frame, int num)
+    {
+      int memOff = -1; // Start at the current instruction
+      BELT_T cur = 0U; // If cur is used uninitialized, that is a bug in the compiler.
+      FlowRetire& retire = machine->flow_retire[slot];
+      if (static_cast<size_t>(num) > BELT_SIZE) // More than the callee's belt, or the retire station, can hold
+       {
+         std::printf("Terminate initiated due to %d arguments for a belt of %d in Flow slot: %d %d\n", num, static_cast<int>(BELT_SIZE),
+            static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+         machine->invalidOp = true;
+         num = static_cast<int>(BELT_SIZE);
+       }
+      for (int i = 0; i < num; ++i)
+       {
+         if (0 == (i % 4)) // memOff is intentionally initialized for this to occur at zero
+          {
+            --memOff;
+            cur = getMemory(frame.flowpc - slot + memOff);
+            if (0U != (cur & INVALID))
+             {
+               machine->invalidOp = true;
+             }
+            if (0x10 != (cur & 0x1F)) // Make sure this is an ARGS NOP
+             {
+               machine->invalidOp = true;
+             }
+          }
+         retire.belt[i] = getBeltContent(frame, (cur >> (5 + 6 * (i % 4))) & 0x3F);
+       }
+    }
+
+   // Without a selector (or with 0), the mask of optional features. Selectors 1 and 2 read the low and high words of counter n.
+   static void gestalt(Machine& machine, const BELT_T* args, BELT_T* rets)
+    {
+      if ((0U != (args[1] & EMPTY)) || (0 == (args[1] & 0xFFFFFFFFLL)))
+       {
+         rets[0] = GESTALT | getZero(GESTALT);
+         return;
+       }
+#ifdef MILL_STATS
+      const BELT_T selector = args[1] & 0xFFFFFFFFLL;
+      if (((1 == selector) || (2 == selector)) && (0U == (args[2] & (INVALID | TRANSIENT | EMPTY))))
+       {
+         std::vector<std::string> names;
+         std::vector<size_t> values;
+         machine.counters.list(names, values);
+         const size_t n = static_cast<size_t>(args[2] & 0xFFFFFFFFLL);
+         if (n < values.size())
+          {
+            const unsigned long long value = values[n];
+            rets[0] = static_cast<BELT_T>((1 == selector) ? (value & 0xFFFFFFFFULL) : (value >> 32));
+            rets[0] |= getZero(rets[0]);
+            return;
+          }
+       }
+#else
+      (void) machine;
+#endif
+      rets[0] = INVALID;
+    }
+
+   static void serviceInterrupt(Machine& machine, int /*serviceCode*/, const BELT_T* args, BELT_T* rets)
+    {
+      const BELT_T code = args[0] & 0xFFFFFFFFLL;
+      if ((true == machine.warming) && ((2 == code) || ((6 <= code) && (code <= 8))))
+       {
+         machine.warm = true; // The core won't retire this cycle.
+         return;
+       }
+      switch (code)
+       {
+         case 1: // request put character, TODO deprecate
+            if (NULL != machine.job)
+             {
+               machine.job->output.push_back(static_cast<unsigned char>(args[1]));
+             }
+            else
+             {
+               putchar(args[1]);
+             }
+            break;
+         case 2: // request get character, TODO deprecate
+            rets[0] = ((NULL != machine.job) ? machine.job->getByte() : HostIO::getByte()) & 0xFFFFFFFFLL;
+            rets[0] |= getZero(rets[0]);
+            break;
+         case 3: // request stop
+            machine.stop = true;
+            break;
+         case 4: // gestalt : which of the optional interrupts there are, or what a selector asks for
+            gestalt(machine, args, rets);
+            break;
+         case 5: // write length bytes of memory, from byte address, to the output : returns how many
+            rets[0] = (NULL != machine.job) ? machine.job->write(machine, args[1], args[2]) : HostIO::write(machine, args[1], args[2]);
+            rets[0] |= getZero(rets[0]);
+            break;
+         case 6: // read up to length bytes of input into memory at byte address : returns how many, zero at the end
+            rets[0] = (NULL != machine.job) ? machine.job->read(machine, args[1], args[2]) : HostIO::read(machine, args[1], args[2], true);
+            rets[0] |= getZero(rets[0]);
+            break;
+         case 7: // poll : how much input can be read without waiting, or -1 at the end of it
+            rets[0] = (NULL != machine.job) ? machine.job->poll() : HostIO::poll();
+            rets[0] |= getZero(rets[0]);
+            break;
+         case 8: // as read, but TRANSIENT rather than waiting when there is no input yet
+            if (NULL != machine.job)
+             {
+               rets[0] = machine.job->read(machine, args[1], args[2]); // All of its input is already here.
+             }
+            else
+             {
+               HostIO::start();
+               rets[0] = HostIO::read(machine, args[1], args[2], false);
+             }
+            rets[0] |= (0U == (rets[0] & TRANSIENT)) ? getZero(rets[0]) : 0U;
+            break;
+         case 9: // copy length bytes from one byte address to another, as memmove : returns how many
+            rets[0] = BulkMemory::copy(machine, args[1], args[2], args[3]);
+            rets[0] |= getZero(rets[0]);
+            break;
+         case 10: // fill length bytes from byte address with a value : returns how many
+            rets[0] = BulkMemory::fill(machine, args[1], args[2], args[3]);
+            rets[0] |= getZero(rets[0]);
+            break;
+         case 11: // compare length bytes at two byte addresses : returns where they first differ, or length
+            rets[0] = BulkMemory::compare(machine, args[1], args[2], args[3]);
+            rets[0] |= getZero(rets[0]);
+            break;
+         case 12: // scan length bytes from byte address for a value : returns where it first is, or length
+            rets[0] = BulkMemory::scan(machine, args[1], args[2], args[3]);
+            rets[0] |= getZero(rets[0]);
+            break;
+         default: // INVALID OPERATION
+            std::printf("Terminate initiated due to invalid interrupt: %lld\n", args[0]);
+            machine.invalidOp = true;
+            break;
+       }
+    }
+
+   virtual void doStuff()
+    {
+      for (;;)
+       {
+         // Wait for the start of the instruction cycle
+         synchronizer->wait();
+         // Do we need to die?
+         if (true == machine->terminate)
+          {
+//            std::printf("Terminating Flow slot: %lu\n", slot);
+            break;
+          }
+         step();
+         // Signal that we have ended this cycle.
+         synchronizer->wait();
+       }
+    }
+
+   // Interpret and execute the next operation.
+   virtual void step()
+    {
+      Frame& frame = machine->frames.back();
+      FlowRetire& retire = machine->flow_retire[slot];
+      retire.flush(); // Make retire station is clean.
+      if (0U != frame.flownop)
+       {
+#ifdef MILL_STATS
+         ++machine->counters.flow[slot][SLOT_ELIDED];
+#endif
+         return;
+       }
+//      std::printf("Executing Flow slot: %lu %lu\n", slot, frame.flowpc);
+      static const FlowDecoded outside (0U); // A fetch from outside of memory executes as a NOP
+      const FlowDecoded* ins = fetchFlow(frame.flowpc - slot - 1U);
+      if (NULL == ins)
+       {
+         std::printf("Terminate initiated due to invalid operation in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+         machine->invalidOp = true;
+         ins = &outside;
+       }
+      execute(frame, retire, ins);
+    }
+
+   void execute(Frame& frame, FlowRetire& retire, const FlowDecoded* ins)
+    {
+      BELT_T cond, src, num, op1, op2, temp;
+      BELT_T* const dests [2] = { retire.fast, &retire.slow };
+      BELT_T* dest;
+      cond = ins->cond;
+      src = getBeltContent(frame, ins->src);
+      num = ins->num;
+      op1 = getBeltContent(frame, ins->a);
+      op2 = getBeltContent(frame, ins->b);
+      dest = dests[ins->slow];
+      retire.nops = ins->nops;
+      retire.next = ins->next;
+#ifdef MILL_STATS
+      ++machine->counters.flow[slot][(0U == ins->code) ? SLOT_NOP : SLOT_OP];
+      if ((2U <= ins->code) && (7U >= ins->code))
+       {
+         ++machine->counters.memory[(ins->code - 2U) / 3U]; // ld, ldh, ldb; st, sth, stb
+       }
+#endif
+
+#ifdef MILL_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+      static void* const handlers [16] =
+       {
+         &&FLOW_NOP, &&FLOW_JMP, &&FLOW_LD, &&FLOW_LDH, &&FLOW_LDB, &&FLOW_ST, &&FLOW_STH, &&FLOW_STB,
+         &&FLOW_CANON, &&FLOW_RET, &&FLOW_JMPI, &&FLOW_CALLI, &&FLOW_CALL, &&FLOW_INT, &&FLOW_INVALID, &&FLOW_INVALID
+       };
+      goto *handlers[ins->code];
+#pragma GCC diagnostic pop
+#else
+      switch (ins->code)
+       {
+         case 0: goto FLOW_NOP;
+         case 1: goto FLOW_JMP;
+         case 2: goto FLOW_LD;
+         case 3: goto FLOW_LDH;
+         case 4: goto FLOW_LDB;
+         case 5: goto FLOW_ST;
+         case 6: goto FLOW_STH;
+         case 7: goto FLOW_STB;
+         case 8: goto FLOW_CANON;
+         case 9: goto FLOW_RET;
+         case 10: goto FLOW_JMPI;
+         case 11: goto FLOW_CALLI;
+         case 12: goto FLOW_CALL;
+         case 13: goto FLOW_INT;
+         default: goto FLOW_INVALID;
+       }
+#endif
+
+FLOW_NOP:
+      return;
+
+FLOW_JMP:
+      if ((0U != (op1 & TRANSIENT)) && conditionTrue(cond, src))
+       {
+         if (0U == (op1 & INVALID))
+          {
+            retire.jump = ((op1 & 0xFFFFFFFFLL) + frame.entryPoint) & 0xFFFFFFFFLL;
+            if (0U == retire.jump)
+             {
+               std::printf("Terminate initiated due to branch to zero in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+               machine->invalidOp = true;
+             }
+          }
+         else
+          {
+            std::printf("Terminate initiated due to branch to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+            machine->invalidOp = true;
+          }
+       }
+#ifdef MILL_STATS
+      ++machine->counters.branches[(0U != retire.jump) ? 1 : 0];
+#endif
+      return;
+
+FLOW_LD:
+      if (conditionTrue(cond, src))
+       {
+         if (false == extraNumerical(op1, temp))
+          {
+            temp = getMemory(op1 & 0xFFFFFFFFLL);
+            if (0U == (temp & INVALID))
+             {
+               temp |= getZero(temp);
+             }
+            else
+             {
+               temp |= frame.flowpc;
+             }
+          }
+         dest[0] = temp;
+       }
+      else
+       {
+         dest[0] = TRANSIENT | frame.flowpc;
+       }
+      return;
+
+FLOW_LDH:
+      if (conditionTrue(cond, src))
+       {
+         if (false == extraNumerical(op1, temp))
+          {
+            temp = getMemory((op1 & 0xFFFFFFFFLL) >> 1);
+            if (0U == (temp & INVALID))
+             {
+               temp >>= 16 * (op1 & 1);
+               if (0U != (temp & 0x8000))
+                {
+                  temp |= 0xFFFF0000LL;
+                }
+               else
+                {
+                  temp &= 0xFFFF;
+                }
+               temp |= getZero(temp);
+             }
+            else
+             {
+               temp |= frame.flowpc;
+             }
+          }
+         dest[0] = temp;
+       }
+      else
+       {
+         dest[0] = TRANSIENT | frame.flowpc;
+       }
+      return;
+
+FLOW_LDB:
+      if (conditionTrue(cond, src))
+       {
+         if (false == extraNumerical(op1, temp))
+          {
+            temp = getMemory((op1 & 0xFFFFFFFFLL) >> 2);
+            if (0U == (temp & INVALID))
+             {
+               temp >>= 8 * (op1 & 3);
+               if (0U != (temp & 0x80))
+                {
+                  temp |= 0xFFFFFF00LL;
+                }
+               else
+                {
+                  temp &= 0xFF;
+                }
+               temp |= getZero(temp);
+             }
+            else
+             {
+               temp |= frame.flowpc;
+             }
+          }
+         dest[0] = temp;
+       }
+      else
+       {
+         dest[0] = TRANSIENT | frame.flowpc;
+       }
+      return;
+
+FLOW_ST:
+      if ((0U == ((op1 | op2) & TRANSIENT)) && conditionTrue(cond, src))
+       {
+         if (0U == ((op1 | op2) & INVALID))
+          {
+            if (INVALID == setMemory(op1 & 0xFFFFFFFFLL, op2 & 0xFFFFFFFFLL))
+             {
+               std::printf("Terminate initiated due to store to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+               machine->invalidOp = true;
+             }
+          }
+         else
+          {
+            std::printf("Terminate initiated due to store of invalid in Flow slot: %d %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U), static_cast<int>(op2));
+            machine->invalidOp = true;
+          }
+       }
+      return;
+
+FLOW_STH:
+      if ((0U == ((op1 | op2) & TRANSIENT)) && conditionTrue(cond, src))
+       {
+         if (0U == ((op1 | op2) & INVALID))
+          {
+            temp = getMemory((op1 & 0xFFFFFFFFLL) >> 1);
+            if (INVALID != temp)
+             {
+               temp &= ~(0xFFFF << (16 * (op1 & 1)));
+               temp |= ((op2 & 0xFFFF) << (16 * (op1 & 1)));
+               setMemory((op1 & 0xFFFFFFFFLL) >> 1, temp);
+             }
+            else
+             {
+               std::printf("Terminate initiated due to store to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+               machine->invalidOp = true;
+             }
+          }
+         else
+          {
+            std::printf("Terminate initiated due to store of invalid in Flow slot: %d %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U), static_cast<int>(op2));
+            machine->invalidOp = true;
+          }
+       }
+      return;
+
+FLOW_STB:
+      if ((0U == ((op1 | op2) & TRANSIENT)) && conditionTrue(cond, src))
+       {
+         if (0U == ((op1 | op2) & INVALID))
+          {
+            temp = getMemory((op1 & 0xFFFFFFFFLL) >> 2);
+            if (INVALID != temp)
+             {
+               temp &= ~(0xFF << (8 * (op1 & 3)));
+               temp |= ((op2 & 0xFF) << (8 * (op1 & 3)));
+               setMemory((op1 & 0xFFFFFFFFLL) >> 2, temp);
+             }
+            else
+             {
+               std::printf("Terminate initiated due to store to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+               machine->invalidOp = true;
+             }
+          }
+         else
+          {
+            std::printf("Terminate initiated due to store of invalid in Flow slot: %d %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U), static_cast<int>(op2));
+            machine->invalidOp = true;
+          }
+       }
+      return;
+
+FLOW_CANON:
+      if (conditionTrue(cond, src))
+       {
+         retire.use = (0U == ins->slow) ? CANON : SLOW_CANON;
+         fillBelt(frame, num);
+       }
+      return;
+
+FLOW_RET:
+      if (conditionTrue(cond, src))
+       {
+         retire.use = SIGNAL_RETURN;
+         fillBelt(frame, num);
+       }
+      return;
+
+FLOW_JMPI:
+      if (conditionTrue(cond, src))
+       {
+         temp = ins->imm;
+         retire.jump = frame.entryPoint + temp;
+         if (0U == retire.jump)
+          {
+            std::printf("Terminate initiated due to branch to zero in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+            machine->invalidOp = true;
+          }
+       }
+#ifdef MILL_STATS
+      ++machine->counters.branches[(0U != retire.jump) ? 1 : 0];
+#endif
+      return;
+
+FLOW_CALLI:
+      temp = ins->imm;
+      retire.jump = frame.entryPoint + temp;
+      if (0U == retire.jump)
+       {
+         std::printf("Terminate initiated due to branch to zero in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+         machine->invalidOp = true;
+       }
+      retire.use = SIGNAL_CALL;
+      fillBelt(frame, num);
+      return;
+
+FLOW_CALL:
+      op2 = ins->rets;
+      if ((0U == (op1 & TRANSIENT)) && conditionTrue(cond, src))
+       {
+         if (0U == (op1 & INVALID))
+          {
+            retire.jump = ((op1 & 0xFFFFFFFFLL) + frame.entryPoint) & 0xFFFFFFFFLL;
+            if (0U == retire.jump)
+             {
+               std::printf("Terminate initiated due to branch to zero in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+               machine->invalidOp = true;
+             }
+            retire.use = SIGNAL_CALL;
+            fillBelt(frame, num);
+          }
+         else
+          {
+            std::printf("Terminate initiated due to branch to invalid in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+            machine->invalidOp = true;
+          }
+       }
+      else
+       {
+         if (0U == (op1 & TRANSIENT))
+          {
+            op1 = TRANSIENT | frame.flowpc;
+          }
+         for (int i = 0; i < op2; ++i)
+          {
+            retire.fast[i] = op1; // ensure TRANSIENT
+          }
+       }
+      return;
+
+FLOW_INT:
+      op1 = ins->service;
+      op2 = ins->rets;
+      if (conditionTrue(cond, src))
+       {
+         fillBelt(frame, num);
+#ifdef MILL_STATS
+         ++machine->counters.interrupts;
+#endif
+         serviceInterrupt(*machine, op1, retire.belt, retire.fast);
+       }
+      else
+       {
+         for (int i = 0; i < op2; ++i)
+          {
+            retire.fast[i] = TRANSIENT | frame.flowpc;
+          }
+       }
+      return;
+
+FLOW_INVALID: // RAISE INVALID OPERATION
+      std::printf("Terminate initiated due to invalid operation in Flow slot: %d %d\n", static_cast<int>(slot), static_cast<int>(frame.flowpc - slot - 1U));
+      machine->invalidOp = true;
+    }
+ };
+
+// Translation of extended basic blocks.
+// Within a block, what executes in each cycle, and the PCs and elided NOP counts after it, depend only
+// on the instruction words, so they can be worked out once: the first time the block is entered.
+static const size_t MAX_TRACE = 256U;
+
+// The state of a Frame's instruction streams at the start of a cycle.
+class TraceKey
+ {
+public:
+   size_t alupc;
+   size_t flowpc;
+   size_t alunop;
+   size_t flownop;
+
+   bool operator == (const TraceKey& rhs) const
+    {
+      return (alupc == rhs.alupc) && (flowpc == rhs.flowpc) && (alunop == rhs.alunop) && (flownop == rhs.flownop);
+    }
+ };
+
+class TraceKeyHash
+ {
+public:
+   size_t operator () (const TraceKey& key) const
+    {
+      return (key.alupc * 0x9E3779B1U) ^ (key.flowpc << 7) ^ (key.alunop << 3) ^ key.flownop;
+    }
+ };
+
+#ifdef MILL_JIT
+// x86-64 machine code for a trace. It is assembled into a buffer, then copied into pages
+// that are mapped writable, and then flipped to executable: never both at once.
+class JitCode
+ {
+public:
+   std::vector<unsigned char> bytes;
+   void* code;
+   size_t size;
+
+   JitCode() : code(NULL), size(0U) { }
+
+   ~JitCode()
+    {
+      if (NULL != code)
+       {
+         munmap(code, size);
+       }
+    }
+
+   void op(unsigned char a) { bytes.push_back(a); }
+   void op(unsigned char a, unsigned char b) { op(a); op(b); }
+   void op(unsigned char a, unsigned char b, unsigned char c) { op(a); op(b); op(c); }
+
+   void imm32(unsigned int value)
+    {
+      for (size_t i = 0U; i < 4U; ++i) op(static_cast<unsigned char>(value >> (8U * i)));
+    }
+
+   void imm64(unsigned long long value)
+    {
+      for (size_t i = 0U; i < 8U; ++i) op(static_cast<unsigned char>(value >> (8U * i)));
+    }
+
+   // Emit a jump's displacement, to be filled in by land once the target is known.
+   size_t rel8() { op(0U); return bytes.size(); }
+   size_t rel32() { imm32(0U); return bytes.size(); }
+
+   void land8(size_t from)
+    {
+      bytes[from - 1U] = static_cast<unsigned char>(bytes.size() - from);
+    }
+
+   void land32(size_t from)
+    {
+      unsigned int disp = static_cast<unsigned int>(bytes.size() - from);
+      for (size_t i = 0U; i < 4U; ++i) bytes[from - 4U + i] = static_cast<unsigned char>(disp >> (8U * i));
+    }
+
+   // Map the code. Returns false if the host won't give us executable memory.
+   bool finish()
+    {
+      size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      size = (bytes.size() + page - 1U) & ~(page - 1U);
+      void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (MAP_FAILED == mem)
+       {
+         return false;
+       }
+      std::memcpy(mem, &bytes[0], bytes.size());
+      if (0 != mprotect(mem, size, PROT_READ | PROT_EXEC))
+       {
+         munmap(mem, size);
+         return false;
+       }
+      code = mem;
+      std::vector<unsigned char>().swap(bytes);
+      return true;
+    }
+ };
+#endif
+
+// One clock cycle of a trace, and the state of the streams after it. Its ALU slots are in the Trace.
+class TraceCycle
+ {
+public:
+   FlowDecoded flow [FLOW_UNITS]; // UNDECODED when the Flow slots are eliding NOPs
+   TraceKey before;
+   TraceKey after;
+ };
+
+class Trace
+ {
+public:
+   std::vector<TraceCycle> cycles; // Empty if the first cycle can't be translated.
+   std::vector<ALUDecoded> alu; // The machine's width of them to a cycle: UNDECODED when the ALU slots are eliding NOPs
+#ifdef MILL_JIT
+   size_t entries; // Times entered, until it is compiled
+   JitCode* native;
+
+   Trace() : entries(0U), native(NULL) { }
+   ~Trace() { delete native; }
+#endif
+ };
+
+class TraceCache
+ {
+public:
+   std::unordered_map<TraceKey, Trace*, TraceKeyHash> traces;
+
+   ~TraceCache()
+    {
+      flush();
+    }
+
+   void flush()
+    {
+      for (std::unordered_map<TraceKey, Trace*, TraceKeyHash>::iterator iter = traces.begin(); traces.end() != iter; ++iter)
+       {
+         delete iter->second;
+       }
+      traces.clear();
+    }
+
+   Trace* find(Machine& machine, const Frame& frame)
+    {
+      TraceKey key;
+      key.alupc = frame.alupc;
+      key.flowpc = frame.flowpc;
+      key.alunop = frame.alunop;
+      key.flownop = frame.flownop;
+      std::unordered_map<TraceKey, Trace*, TraceKeyHash>::const_iterator iter = traces.find(key);
+      if (traces.end() != iter)
+       {
+         return iter->second;
+       }
+      Trace* trace = (4U == machine.width) ? translate<4U>(machine, key) :
+         ((8U == machine.width) ? translate<8U>(machine, key) : translate<2U>(machine, key));
+      traces.insert(std::make_pair(key, trace));
+      return trace;
+    }
+
+   // Follow the streams from key until the block unconditionally leaves, or we run out of room.
+   // A cycle that would fetch from outside of memory isn't translated: the interpreter reports it.
+   template <size_t ALUS>
+   static Trace* translate(Machine& machine, TraceKey key)
+    {
+      Trace* trace = new Trace();
+      bool done = false;
+      while ((false == done) && (trace->cycles.size() < MAX_TRACE))
+       {
+         TraceCycle cycle;
+         ALUDecoded alu [ALUS];
+         cycle.before = key;
+         size_t aluNops = 0U;
+         size_t flowNops = 0U;
+         size_t flowNext = 0U;
+         if (0U == key.alunop)
+          {
+            for (size_t i = 0U; i < ALUS; ++i)
+             {
+               size_t location = key.alupc + i;
+               if (location >= machine.memsize)
+                {
+                  return trace;
+                }
+               alu[i].decode(machine.memory[location]);
+               machine.traced[location] = 1U;
+               aluNops += alu[i].nops;
+             }
+          }
+         if (0U == key.flownop)
+          {
+            for (size_t i = 0U; i < FLOW_UNITS; ++i)
+             {
+               size_t location = key.flowpc - i - 1U;
+               if (location >= machine.memsize)
+                {
+                  return trace;
+                }
+               FlowDecoded& ins = cycle.flow[i];
+               ins.decode(machine.memory[location]);
+               for (size_t j = 0U; (j <= ins.next) && (location - j < machine.memsize); ++j)
+                {
+                  machine.traced[location - j] = 1U; // The instruction and its ARGS
+                }
+               flowNops += ins.nops;
+               flowNext += ins.next;
+               if (((10U == ins.code) && (0U == ins.cond)) || // JMPI always
+                   ((9U == ins.code) && (0U == ins.cond)) || // RET always
+                   (11U == ins.code)) // CALLI
+                {
+                  done = true;
+                }
+             }
+          }
+         // This is MillCore::advance
+         if (0U != key.alunop)
+          {
+            --key.alunop;
+          }
+         else
+          {
+            key.alupc += ALUS;
+          }
+         if (0U != key.flownop)
+          {
+            --key.flownop;
+          }
+         else
+          {
+            key.flowpc -= (FLOW_UNITS + flowNext);
+          }
+         key.alunop += flowNops;
+         key.flownop += aluNops;
+         cycle.after = key;
+         trace->cycles.push_back(cycle);
+         trace->alu.insert(trace->alu.end(), alu, alu + ALUS);
+       }
+      return trace;
+    }
+ };
+
+// Periodic checkpoints. name.0 is a Core, and each name.N after it is a delta: the pages stored to
+// since name.N-1, and the frame stack. A fork()ed child writes each one from its copy-on-write view
+// of the machine, so the core doesn't wait on the disk.
+class Checkpoint
+ {
+public:
+   size_t interval; // Cycles between checkpoints: 0 for none
+   size_t next; // When the next one is due
+   size_t sequence;
+   std::string name;
+   pid_t writer;
+
+   Checkpoint() : interval(0U), next(0U), sequence(0U), name("MillULX.ckpt"), writer(-1) { }
+
+   // Name a new chain after the image (or MillULX, for none) and this process, so that runs side by side
+   // don't write over each other's links.
+   void start(const char * image)
+    {
+      std::string base ((NULL == image) ? "MillULX" : image);
+      base.erase(0U, base.rfind('/') + 1U);
+      char pid [24U];
+      std::snprintf(pid, sizeof(pid), ".%ld.ckpt", static_cast<long>(getpid()));
+      name = base + pid;
+    }
+
+   std::string file(size_t n) const
+    {
+      char number [24U];
+      std::snprintf(number, sizeof(number), ".%lu", static_cast<unsigned long>(n));
+      return name + number;
+    }
+
+   // Carry on the chain that the running image was restored from, dropping what followed it.
+   void resume(const std::string& stem, size_t last)
+    {
+      name = stem;
+      sequence = last + 1U;
+      for (size_t n = sequence; 0 == std::remove(file(n).c_str()); ++n) { }
+    }
+
+   // Called between cycles.
+   void take(Machine& machine, size_t cycles)
+    {
+      wait(); // The chain is only good if each link is written before the next.
+      std::vector<size_t> pages;
+      for (size_t i = 0U; i < machine.dirty.size(); ++i)
+       {
+         if (0U != (SINCE_CHECKPOINT & machine.dirty[i]))
+          {
+            pages.push_back(i);
+            machine.dirty[i] &= ~SINCE_CHECKPOINT;
+          }
+       }
+      // Another thread (a threaded unit, the input reader) may hold a lock of stdio or of the heap at the fork,
+      // so the child may only make async-signal-safe calls: the link is laid out here, and the child writes it.
+      char * link = NULL;
+      size_t length = 0U;
+      std::FILE * out = open_memstream(&link, &length);
+      if (NULL == out)
+       {
+         return;
+       }
+      if (0U == sequence)
+       {
+         machine.writeCore(out);
+       }
+      else
+       {
+         machine.writeDelta(out, sequence, pages);
+       }
+      std::fclose(out);
+      const std::string to = file(sequence);
+      const std::string temp = to + ".new";
+      writer = fork();
+      if (0 == writer)
+       {
+         _exit(put(temp.c_str(), to.c_str(), link, length) ? 0 : 1); // Don't flush the parent's stdio buffers a second time.
+       }
+      else if (writer < 0)
+       {
+         put(temp.c_str(), to.c_str(), link, length);
+       }
+      std::free(link);
+      ++sequence;
+      next = cycles + interval;
+    }
+
+   // With nothing but system calls, for the child.
+   static bool put(const char * temp, const char * to, const char * link, size_t length)
+    {
+      const int fd = ::open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+       {
+         return false;
+       }
+      size_t done = 0U;
+      while (done < length)
+       {
+         const ssize_t wrote = ::write(fd, link + done, length - done);
+         if (wrote <= 0)
+          {
+            break;
+          }
+         done += static_cast<size_t>(wrote);
+       }
+      ::close(fd);
+      return (done == length) && (0 == ::rename(temp, to));
+    }
+
+   void wait()
+    {
+      if (writer > 0)
+       {
+         waitpid(writer, NULL, 0);
+       }
+      writer = -1;
+    }
+ };
+
+// A sampling profiler. When a sample is due, the cycles since the last one are charged to where the
+// core is: the chain of entry points of the frame stack, and the block and PCs of the running frame.
+// Samples are taken between cycles (between traces, for -trace and -jit), every so many cycles, or
+// at the next gap after a SIGPROF from a CPU time timer.
+class Profiler
+ {
+public:
+   // Of one extended basic block, by entry point.
+   class Block
+    {
+   public:
+      size_t cycles;
+      size_t samples;
+      std::unordered_map<size_t, size_t> pcs; // Cycles by (alupc - entry) << 32 | (entry - flowpc)
+
+      Block() : cycles(0U), samples(0U) { }
+    };
+
+   bool on;
+   size_t interval; // Cycles between samples: 0 to sample on SIGPROF
+   size_t next; // When the next one is due
+   size_t last; // The cycle of the last sample
+   std::unordered_map<std::string, size_t> stacks; // Cycles by folded stack
+   std::unordered_map<size_t, Block> blocks;
+   static volatile sig_atomic_t signalled;
+
+   Profiler() : on(false), interval(0U), next(0U), last(0U) { }
+
+   static void onSignal(int)
+    {
+      signalled = 1;
+    }
+
+   void start(size_t cycles)
+    {
+      next = cycles + interval;
+      last = cycles;
+      if (0U == interval)
+       {
+         struct sigaction action;
+         std::memset(static_cast<void*>(&action), 0, sizeof(action));
+         action.sa_handler = onSignal;
+         action.sa_flags = SA_RESTART;
+         sigaction(SIGPROF, &action, NULL);
+         itimerval timer;
+         timer.it_interval.tv_sec = 0;
+         timer.it_interval.tv_usec = 1000; // A sample each millisecond of CPU time
+         timer.it_value = timer.it_interval;
+         setitimer(ITIMER_PROF, &timer, NULL);
+       }
+    }
+
+   void stop()
+    {
+      if (0U == interval)
+       {
+         itimerval timer;
+         std::memset(static_cast<void*>(&timer), 0, sizeof(timer));
+         setitimer(ITIMER_PROF, &timer, NULL);
+       }
+    }
+
+   bool due(size_t cycles) const
+    {
+      return (0U != interval) ? (cycles >= next) : (0 != signalled);
+    }
+
+   void sample(const Machine& machine, size_t cycles)
+    {
+      signalled = 0;
+      next = cycles + interval;
+      const size_t weight = cycles - last;
+      last = cycles;
+      if (0U == weight)
+       {
+         return;
+       }
+      std::string stack;
+      char name [24];
+      for (size_t i = 0U; i < machine.frames.size(); ++i)
+       {
+         std::snprintf(name, sizeof(name), "%s0x%lx", (0U == i) ? "" : ";", static_cast<unsigned long>(machine.frames[i].entryPoint));
+         stack += name;
+       }
+      stacks[stack] += weight;
+      const Frame& frame = machine.frames.back();
+      Block& block = blocks[frame.entryPoint];
+      block.cycles += weight;
+      ++block.samples;
+      block.pcs[((frame.alupc - frame.entryPoint) << 32) | ((frame.entryPoint - frame.flowpc) & 0xFFFFFFFFU)] += weight;
+    }
+
+   // Folded stacks, as flame graph tools take them, and a table of the blocks by cycles.
+   void write(const char * folded, const char * flat) const
+    {
+      std::FILE * file = std::fopen(folded, "w");
+      if (NULL != file)
+       {
+         for (std::unordered_map<std::string, size_t>::const_iterator iter = stacks.begin(); stacks.end() != iter; ++iter)
+          {
+            std::fprintf(file, "%s %lu\n", iter->first.c_str(), static_cast<unsigned long>(iter->second));
+          }
+         std::fclose(file);
+       }
+      std::vector<std::pair<size_t, size_t> > order; // Cycles, entry point
+      size_t total = 0U;
+      for (std::unordered_map<size_t, Block>::const_iterator iter = blocks.begin(); blocks.end() != iter; ++iter)
+       {
+         order.push_back(std::make_pair(iter->second.cycles, iter->first));
+         total += iter->second.cycles;
+       }
+      std::sort(order.rbegin(), order.rend());
+      file = std::fopen(flat, "w");
+      if (NULL == file)
+       {
+         return;
+       }
+      std::fprintf(file, "%12s %7s %8s %10s  %s\n", "cycles", "%", "samples", "entry", "hottest alupc/flowpc");
+      for (size_t i = 0U; i < order.size(); ++i)
+       {
+         const Block& block = blocks.find(order[i].second)->second;
+         size_t hottest = 0U;
+         size_t most = 0U;
+         for (std::unordered_map<size_t, size_t>::const_iterator iter = block.pcs.begin(); block.pcs.end() != iter; ++iter)
+          {
+            if ((iter->second > most) || ((iter->second == most) && (iter->first < hottest)))
+             {
+               hottest = iter->first;
+               most = iter->second;
+             }
+          }
+         std::fprintf(file, "%12lu %6.2f%% %8lu %#10lx  %#lx/%#lx\n", static_cast<unsigned long>(order[i].first),
+            100.0 * static_cast<double>(order[i].first) / static_cast<double>(total), static_cast<unsigned long>(block.samples),
+            static_cast<unsigned long>(order[i].second), static_cast<unsigned long>(order[i].second + (hottest >> 32)),
+            static_cast<unsigned long>(order[i].second - (hottest & 0xFFFFFFFFU)));
+       }
+      std::fclose(file);
+    }
+ };
+
+volatile sig_atomic_t Profiler::signalled = 0;
+
+enum Engine
+ {
+   ENGINE_INLINE, // Every unit runs on the core's thread.
+   ENGINE_THREADED, // One thread per unit, synchronized by a barrier.
+   ENGINE_TRACE, // Inline, running translated blocks.
+   ENGINE_JIT // As ENGINE_TRACE, with hot traces compiled to native code.
+ };
+
+static const char * engineName(Engine engine)
+ {
+   static const char * const names [] = { "inline", "threaded", "trace", "jit" };
+   return names[engine];
+ }
+
+// For -bench: the wall time of a run and, where the host will count them, the instructions it took.
+class Stopwatch
+ {
+public:
+   bool on;
+   struct timespec begun;
+   double seconds;
+   int counter; // A perf event counting this process's (and its threads') user instructions, or -1
+   unsigned long long instructions;
+   bool counted;
+
+   Stopwatch() : on(false), seconds(0.0), counter(-1), instructions(0U), counted(false) { }
+
+   unsigned long long read() const
+    {
+      unsigned long long count = 0U;
+      if ((-1 == counter) || (sizeof(count) != static_cast<size_t>(::read(counter, &count, sizeof(count)))))
+       {
+         return 0U;
+       }
+      return count;
+    }
+
+   void start()
+    {
+#ifdef __linux__
+      struct perf_event_attr attr;
+      std::memset(static_cast<void*>(&attr), 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.inherit = 1; // The threaded engine's units
+      counter = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0UL));
+#endif
+      instructions = read();
+      clock_gettime(CLOCK_MONOTONIC, &begun);
+    }
+
+   void stop()
+    {
+      struct timespec ended;
+      clock_gettime(CLOCK_MONOTONIC, &ended);
+      seconds = (ended.tv_sec - begun.tv_sec) + (ended.tv_nsec - begun.tv_nsec) / 1e9;
+      if (-1 != counter)
+       {
+         instructions = read() - instructions; // The units have been joined, so their counts are in.
+         counted = (0U != instructions);
+         close(counter);
+         counter = -1;
+       }
+    }
+
+   // One JSON object, on one line.
+   void print(std::FILE * file, Engine engine, size_t cycles) const
+    {
+      std::fprintf(file, "{\"engine\": \"%s\", \"cycles\": %lu, \"seconds\": %.6f, \"cycles_per_second\": %.0f, ",
+         engineName(engine), static_cast<unsigned long>(cycles), seconds, (0.0 < seconds) ? cycles / seconds : 0.0);
+      if ((true == counted) && (0U != cycles))
+       {
+         std::fprintf(file, "\"instructions\": %llu, \"instructions_per_cycle\": %.2f}\n",
+            instructions, static_cast<double>(instructions) / cycles);
+       }
+      else
+       {
+         std::fprintf(file, "\"instructions\": null, \"instructions_per_cycle\": null}\n");
+       }
+    }
+ };
+
+enum StatsReport
+ {
+   STATS_NONE,
+   STATS_TEXT,
+   STATS_JSON
+ };
+
+class MillCore
+ {
+public:
+   Machine* machine;
+   Engine engine;
+   SyncKind sync; // How the threaded engine synchronizes.
+   TraceCache traces;
+   bool redirected; // Set by retireCycle when control leaves the straight-line path
+   Drops drops; // What retireCycle is putting on the belts
+   size_t cycles; // Retired
+   Checkpoint checkpoint;
+   const char * servePath; // For -serve and -forkserver
+   bool serveForking;
+   StatsReport stats; // What to print of the counters at exit
+   Profiler profiler;
+   size_t recording; // How many records the recorder keeps: 0 for none
+   Recorder recorder;
+   size_t limit; // Stop once this many cycles have retired: 0 for no limit
+   size_t until; // The cycle count at which limit stops this run: 0 for none
+   Stopwatch stopwatch;
+   const char * corePath; // Where the machine is saved at the end: NULL not to
+
+   MillCore() : machine(NULL), engine(ENGINE_TRACE), sync(SYNC_HYBRID), redirected(false), cycles(0U),
+      servePath(NULL), serveForking(false), stats(STATS_NONE), recording(0U), limit(0U), until(0U), corePath("MillULX.core") { }
+
+   static void * runMe(void * slot)
+    {
+      MillCore* unit = reinterpret_cast<MillCore*>(slot);
+      unit->doStuff();
+      return NULL;
+    }
+
+   static void * runOne(void * slot)
+    {
+      FunctionalUnit* unit = reinterpret_cast<FunctionalUnit*>(slot);
+      unit->doStuff();
+      return NULL;
+    }
+
+   // Retire the results of the cycle that just finished.
+   // Returns true when the core should stop.
+   template <size_t ALUS>
+   bool endCycle()
+    {
+      if (true == machine->warm)
+       {
+         return true; // Leave the machine as it was at the start of the cycle.
+       }
+      // Synthesize unit data.
+//      std::printf("Instruction finished\n");
+      advance<ALUS>(&machine->frames.back());
+      return retireCycle<ALUS>();
+    }
+
+   template <size_t ALUS>
+   void advance(Frame* frame)
+    {
+//  Dec NOP counters OR move PCs
+//    IF we performed an instruction, move the PC while we have the data to do so.
+      if (0U != frame->alunop)
+       {
+         --frame->alunop;
+       }
+      else
+       {
+         frame->alupc += ALUS;
+       }
+      if (0U != frame->flownop)
+       {
+         --frame->flownop;
+       }
+      else
+       {
+         //  Accumulate flow delta
+         size_t addPC = 0U;
+         for (size_t i = 0U; i < FLOW_UNITS; ++i)
+          {
+            addPC += machine->flow_retire[i].next;
+          }
+         frame->flowpc -= (FLOW_UNITS + addPC);
+       }
+//  Accumulate NOPs and add to counters
+      size_t addNops = 0U;
+      for (size_t i = 0U; i < FLOW_UNITS; ++i)
+       {
+         addNops += machine->flow_retire[i].nops;
+       }
+      frame->alunop += addNops;
+      addNops = 0U;
+      for (size_t i = 0U; i < ALUS; ++i)
+       {
+         addNops += machine->alu_retire[i].nops;
+       }
+      frame->flownop += addNops;
+    }
+
+   // Retire the values, and perform the branches, calls and returns, of this cycle.
+   // Returns true when the core should stop.
+   template <size_t ALUS>
+   bool retireCycle()
+    {
+      ++cycles;
+//  Retire ALUs
+      for (size_t i = 0U; i < ALUS; ++i)
+       {
+         for (size_t j = 0U; (j < ALU_RETIRE_SIZE) && (0U == (EMPTY & machine->alu_retire[i].fast[j])); ++j)
+          {
+            drops.dropFast(machine->alu_retire[i].fast[j]);
+          }
+         for (size_t j = 0U; (j < ALU_RETIRE_SIZE) && (0U == (EMPTY & machine->alu_retire[i].slow[j])); ++j)
+          {
+            drops.dropSlow(machine->alu_retire[i].slow[j]);
+          }
+       }
+      return retireFlows();
+    }
+
+   // The rest of retireCycle, which is the same at every width: there is one copy of it, not one for each.
+   bool retireFlows()
+    {
+#ifdef MILL_STATS
+      Counters& counters = machine->counters;
+      ++counters.cycles;
+#endif
+      Frame* frame = &machine->frames.back();
+//  Retire Flows
+      for (size_t i = 0U; i < FLOW_UNITS; ++i)
+       {
+         for (size_t j = 0U; (j < FLOW_RETIRE_SIZE) && (0U == (EMPTY & machine->flow_retire[i].fast[j])); ++j)
+          {
+            drops.dropFast(machine->flow_retire[i].fast[j]);
+          }
+         if (0U == (EMPTY & machine->flow_retire[i].slow))
+          {
+            drops.dropSlow(machine->flow_retire[i].slow);
+          }
+         // The first non-call branch wins and stops flow unit processing
+         if ((0U == frame->nextpc) && (0U != machine->flow_retire[i].jump) && (SIGNAL_CALL != machine->flow_retire[i].use))
+          {
+            frame->nextpc = machine->flow_retire[i].jump;
+            break;
+          }
+         switch (machine->flow_retire[i].use)
+          {
+            case NOT_IN_USE:
+               break;
+            case CANON:
+#ifdef MILL_STATS
+               ++counters.canons;
+#endif
+               drops.retire(*frame);
+               frame->ffront = 0U;
+               frame->fsize = 0U;
+               for (size_t j = 0U; (j < BELT_SIZE) && (0U == (EMPTY & machine->flow_retire[i].belt[j])); ++j)
+                {
+                  drops.dropFast(machine->flow_retire[i].belt[j]);
+                }
+               break;
+            case SLOW_CANON:
+#ifdef MILL_STATS
+               ++counters.canons;
+#endif
+               drops.retire(*frame);
+               frame->sfront = 0U;
+               frame->ssize = 0U;
+               for (size_t j = 0U; (j < BELT_SIZE) && (0U == (EMPTY & machine->flow_retire[i].belt[j])); ++j)
+                {
+                  drops.dropSlow(machine->flow_retire[i].belt[j]);
+                }
+               break;
+            case SIGNAL_CALL:
+             {
+               frame->index = i; // When we return, we will return to this index.
+               // The retire phase has been carefully constructed so that (hopefully) we can treat a call as an instruction
+               // that retires a variable number of values.
+               // And that we can create and destroy frames in this loop without invalidating the machine state.
+               redirected = true;
+               drops.retire(*frame);
+               for (size_t j = i + 1U; j < FLOW_UNITS; ++j)
+                {
+                  machine->parked.push_back(machine->flow_retire[j]);
+                }
+               frame = &machine->frames.push();
+               frame->init();
+#ifdef MILL_STATS
+               ++counters.calls;
+               counters.depth = std::max(counters.depth, machine->frames.size());
+#endif
+               for (size_t j = 0U; (j < BELT_SIZE) && (0U == (EMPTY & machine->flow_retire[i].belt[j])); ++j)
+                {
+                  drops.dropFast(machine->flow_retire[i].belt[j]);
+                }
+               frame->nextpc = machine->flow_retire[i].jump;
+               i = FLOW_UNITS; // Don't process any of the new frame's flow retire stations.
+             }
+               break;
+            case SIGNAL_RETURN:
+#ifdef MILL_STATS
+               ++counters.returns;
+#endif
+               if (1U != machine->frames.size())
+                {
+                  redirected = true;
+                  Frame* prevFrame = &machine->frames[machine->frames.size() - 2U];
+                  drops.retire(*frame);
+                  for (size_t j = 0U; (j < BELT_SIZE) && (0U == (EMPTY & machine->flow_retire[i].belt[j])); ++j)
+                   {
+                     drops.dropFast(machine->flow_retire[i].belt[j]);
+                   }
+                  drops.retire(*prevFrame);
+                  machine->frames.pop();
+                  frame = &machine->frames.back(); // Don't use prevFrame.
+                  i = frame->index;
+                  for (size_t j = FLOW_UNITS - 1U; j > i; --j)
+                   {
+                     machine->flow_retire[j] = machine->parked.back();
+                     machine->parked.pop_back();
+                   }
+                }
+               else
+                {
+                  // Returning from the bottommost frame exits.
+                  machine->stop = true;
+                }
+               break;
+          }
+       }
+      drops.retire(*frame);
+      if (0U != frame->nextpc)
+       {
+         redirected = true;
+         frame->alupc = frame->nextpc;
+         frame->flowpc = frame->nextpc;
+         frame->entryPoint = frame->nextpc;
+         frame->nextpc = 0U;
+       }
+/*
+// You know you're in deep when you have to uncomment this block.
+std::printf("%x %x %x %x %x %x %x %x %x %x %x %x\n",
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 0)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 1)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 2)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 3)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 4)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 5)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 6)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 7)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 8)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 9)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 10)),
+   static_cast<char>(FunctionalUnit::getBeltContent(*frame, 11)));
+*/
+      return halted();
+    }
+
+   // Whether the cycle that just retired ended the run.
+   bool halted()
+    {
+      if ((0U != until) && (cycles >= until))
+       {
+         machine->stop = true; // As if the guest quit in this cycle
+       }
+      if ((true == machine->invalidOp) || (true == machine->stop))
+       {
+         if (true == machine->invalidOp)
+          {
+#ifdef MILL_LAZY_CORE
+            if ((NULL != machine->lazy) && (true == machine->lazy->damaged.exchange(false)))
+             {
+               std::printf("Terminate initiated due to a damaged chunk of memory in the core\n");
+             }
+#endif
+            std::printf("Terminating Core due to invalid operation\n");
+          }
+         return true;
+       }
+      return false;
+    }
+
+   // Called between cycles, when no unit is running.
+   void tick()
+    {
+      if ((0U != checkpoint.interval) && (cycles >= checkpoint.next))
+       {
+         checkpoint.take(*machine, cycles);
+       }
+      if ((true == profiler.on) && (true == profiler.due(cycles)))
+       {
+         profiler.sample(*machine, cycles);
+       }
+      if (0 != Recorder::requested)
+       {
+         recorder.write("MillULX.rec", cycles);
+       }
+    }
+
+   // Give the recorder the PCs of the cycle about to run.
+   void record()
+    {
+      if (NULL != machine->recorder)
+       {
+         const Frame& frame = machine->frames.back();
+         machine->recorder->cycle(cycles, frame.alupc, frame.flowpc);
+       }
+    }
+
+   // Every unit runs on this thread, in slot order, and then the core retires.
+   // The units only read the belts and write their own retire stations, so this
+   // gives the same results as the threaded engine without any synchronization.
+   template <size_t ALUS>
+   void runInline(ALUnit* aunits, FlowUnit* funits)
+    {
+      for (;;)
+       {
+         record();
+         for (size_t i = 0U; i < ALUS; ++i)
+          {
+            aunits[i].step();
+          }
+         for (size_t i = 0U; i < FLOW_UNITS; ++i)
+          {
+            funits[i].step();
+          }
+         if (true == endCycle<ALUS>())
+          {
+            machine->terminate = true;
+            break;
+          }
+         tick();
+       }
+    }
+
+   // Run the cycles of a trace, until it ends or control leaves it. Returns true when the core should stop.
+   template <size_t ALUS>
+   bool runTrace(const Trace& trace, ALUnit* aunits, FlowUnit* funits)
+    {
+      Frame& frame = machine->frames.back();
+      Recorder* const recorder = machine->recorder;
+      redirected = false;
+      for (size_t c = 0U; c < trace.cycles.size(); ++c)
+       {
+         const TraceCycle& cycle = trace.cycles[c];
+         const ALUDecoded* alu = &trace.alu[c * ALUS];
+         if (NULL != recorder)
+          {
+            recorder->cycle(cycles, frame.alupc, frame.flowpc);
+          }
+         for (size_t i = 0U; i < ALUS; ++i)
+          {
+            ALURetire& retire = machine->alu_retire[i];
+            retire.flush();
+            if (UNDECODED != alu[i].code)
+             {
+               aunits[i].execute(frame, retire, &alu[i]);
+             }
+#ifdef MILL_STATS
+            else
+             {
+               ++machine->counters.alu[i][SLOT_ELIDED];
+             }
+#endif
+          }
+         for (size_t i = 0U; i < FLOW_UNITS; ++i)
+          {
+            FlowRetire& retire = machine->flow_retire[i];
+            retire.flush();
+            if (UNDECODED != cycle.flow[i].code)
+             {
+               funits[i].execute(frame, retire, &cycle.flow[i]);
+             }
+#ifdef MILL_STATS
+            else
+             {
+               ++machine->counters.flow[i][SLOT_ELIDED];
+             }
+#endif
+          }
+         frame.alupc = cycle.after.alupc;
+         frame.flowpc = cycle.after.flowpc;
+         frame.alunop = cycle.after.alunop;
+         frame.flownop = cycle.after.flownop;
+         if (true == retireCycle<ALUS>())
+          {
+            return true;
+          }
+         if ((true == redirected) || (true == machine->tracesStale)) // A call may have moved frame.
+          {
+            break;
+          }
+       }
+      return false;
+    }
+
+#ifdef MILL_JIT
+   typedef int (*JitEntry)(MillCore* core, Frame* frame, ALUnit* aunits, FlowUnit* funits);
+
+   // What compiled code calls for the work it doesn't do in line.
+   static void jitALU(ALUnit* unit, Frame* frame, const ALUDecoded* ins)
+    {
+      ALURetire& retire = unit->machine->alu_retire[unit->slot];
+      retire.flush();
+      unit->execute(*frame, retire, ins);
+    }
+
+   static void jitFlow(FlowUnit* unit, Frame* frame, const FlowDecoded* ins)
+    {
+      FlowRetire& retire = unit->machine->flow_retire[unit->slot];
+      retire.flush();
+      if (UNDECODED != ins->code)
+       {
+         unit->execute(*frame, retire, ins);
+       }
+    }
+
+   static void jitFlush(FlowRetire* retire)
+    {
+      retire->flush();
+    }
+
+   static void jitStore(Machine* machine, size_t location, MEM_T value)
+    {
+      machine->memory[location] = value;
+      machine->invalidate(location);
+    }
+
+   // 0 to carry on, 1 to leave the trace, 2 to stop the core.
+   template <size_t ALUS>
+   static int jitRetire(MillCore* core)
+    {
+      if (true == core->retireCycle<ALUS>())
+       {
+         return 2;
+       }
+      return jitCheck(core);
+    }
+
+   static int jitCheck(MillCore* core)
+    {
+      if (true == core->halted())
+       {
+         return 2;
+       }
+      if ((true == core->redirected) || (true == core->machine->tracesStale))
+       {
+         return 1;
+       }
+      return 0;
+    }
+
+   static void jitCall(JitCode& jit, const void* function)
+    {
+      jit.op(0x48, 0xB8); // mov rax, function
+      jit.imm64(reinterpret_cast<size_t>(function));
+      jit.op(0xFF, 0xD0); // call rax
+    }
+
+   // rax = getBeltContent(frame, location), with the frame in rbx.
+   static void jitBelt(JitCode& jit, size_t location)
+    {
+      const bool fast = (0U == (location & OPERAND_SLOW));
+      if (OPERAND_CONSTANTS <= (location & OPERAND_POSITION))
+       {
+         jit.op(0x48, 0xB8); // mov rax, constant
+         jit.imm64(FunctionalUnit::beltConstant(location));
+         return;
+       }
+      jit.op(0x48, 0x83, 0xBB); // cmp qword [rbx + size], location
+      jit.imm32(static_cast<unsigned int>(fast ? offsetof(Frame, fsize) : offsetof(Frame, ssize)));
+      jit.op(static_cast<unsigned char>(location & OPERAND_POSITION));
+      jit.op(0x76); // jbe invalid
+      size_t invalid = jit.rel8();
+      jit.op(0x48, 0x8B, 0x83); // mov rax, [rbx + front]
+      jit.imm32(static_cast<unsigned int>(fast ? offsetof(Frame, ffront) : offsetof(Frame, sfront)));
+      jit.op(0x48, 0x83, 0xC0); // add rax, location
+      jit.op(static_cast<unsigned char>(location));
+      jit.op(0x83, 0xE0, static_cast<unsigned char>(BELT_MASK)); // and eax, BELT_MASK
+      jit.op(0x48, 0x8B, 0x84); // mov rax, [rbx + belt + rax * 8]
+      jit.op(0xC3);
+      jit.imm32(static_cast<unsigned int>(fast ? offsetof(Frame, fast.slot) : offsetof(Frame, slow.slot)));
+      jit.op(0xEB); // jmp done
+      size_t done = jit.rel8();
+      jit.land8(invalid);
+      jit.op(0x48, 0xB8); // mov rax, INVALID
+      jit.imm64(INVALID);
+      jit.land8(done);
+    }
+
+   // Drop the value at [r15 + from] on a belt.
+   static void jitRetireValue(JitCode& jit, size_t from, bool slow)
+    {
+      const unsigned int front = static_cast<unsigned int>(slow ? offsetof(Frame, sfront) : offsetof(Frame, ffront));
+      const unsigned int size = static_cast<unsigned int>(slow ? offsetof(Frame, ssize) : offsetof(Frame, fsize));
+      const unsigned int belt = static_cast<unsigned int>(slow ? offsetof(Frame, slow.slot) : offsetof(Frame, fast.slot));
+      jit.op(0x49, 0x8B, 0x8F); // mov rcx, [r15 + from]
+      jit.imm32(static_cast<unsigned int>(from));
+      jit.op(0x48, 0x8B, 0x83); // mov rax, [rbx + front]
+      jit.imm32(front);
+      jit.op(0x48, 0x83, 0xE8); // sub rax, 1
+      jit.op(0x01);
+      jit.op(0x83, 0xE0, static_cast<unsigned char>(BELT_MASK)); // and eax, BELT_MASK
+      jit.op(0x48, 0x89, 0x83); // mov [rbx + front], rax
+      jit.imm32(front);
+      jit.op(0x48, 0x89, 0x8C); // mov [rbx + belt + rax * 8], rcx
+      jit.op(0xC3);
+      jit.imm32(belt);
+      jit.op(0x48, 0x8B, 0x93); // mov rdx, [rbx + size]
+      jit.imm32(size);
+      jit.op(0x48, 0x83, 0xFA); // cmp rdx, BELT_SIZE
+      jit.op(static_cast<unsigned char>(BELT_SIZE));
+      jit.op(0x48, 0x83, 0xD2); // adc rdx, 0 : one more, if below
+      jit.op(0x00);
+      jit.op(0x48, 0x89, 0x93); // mov [rbx + size], rdx
+      jit.imm32(size);
+    }
+
+   // Where a retire station is, from r15.
+   size_t aluStation(size_t slot) const
+    {
+      return slot * sizeof(ALURetire);
+    }
+
+   size_t flowStation(size_t slot) const
+    {
+      return static_cast<size_t>(reinterpret_cast<const char*>(&machine->flow_retire[slot]) -
+         reinterpret_cast<const char*>(machine->alu_retire));
+    }
+
+   static bool jitInlineALU(const ALUDecoded& ins)
+    {
+      return (UNDECODED == ins.code) || (0U == ins.code) || (22U == ins.code) || (23U == ins.code) || (ins.code >= 29U);
+    }
+
+   // Whether an unconditional load or store byte, which are the bulk of what the Flow slots do.
+   static bool jitInlineFlow(const FlowDecoded& ins)
+    {
+      return (UNDECODED == ins.code) || (0U == ins.code) || (((4U == ins.code) || (7U == ins.code)) && (0U == ins.cond));
+    }
+
+   // NOPs, and the immediate forms of add, sub, and, or and xor, are done in line.
+   // They have no condition, and an immediate never has metadata, so all that
+   // extraNumerical can do is pass a TRANSIENT or INVALID operand through.
+   void jitALUSlot(JitCode& jit, const ALUDecoded& ins, size_t slot)
+    {
+      const size_t station = aluStation(slot);
+      const bool elided = (UNDECODED == ins.code);
+      if (false == jitInlineALU(ins))
+       {
+         jit.op(0x49, 0x8D, 0xBD); // lea rdi, [r13 + slot]
+         jit.imm32(static_cast<unsigned int>(slot * sizeof(ALUnit)));
+         jit.op(0x48, 0x89, 0xDE); // mov rsi, rbx
+         jit.op(0x48, 0xBA); // mov rdx, ins
+         jit.imm64(reinterpret_cast<size_t>(&ins));
+         jitCall(jit, reinterpret_cast<const void*>(&jitALU));
+         return;
+       }
+
+      jit.op(0x48, 0xB9); // mov rcx, EMPTY
+      jit.imm64(EMPTY);
+      for (size_t i = 0U; i < ALU_RETIRE_SIZE; ++i)
+       {
+         jit.op(0x49, 0x89, 0x8F); // mov [r15 + fast], rcx
+         jit.imm32(static_cast<unsigned int>(station + offsetof(ALURetire, fast) + i * sizeof(BELT_T)));
+         jit.op(0x49, 0x89, 0x8F); // mov [r15 + slow], rcx
+         jit.imm32(static_cast<unsigned int>(station + offsetof(ALURetire, slow) + i * sizeof(BELT_T)));
+       }
+      jit.op(0x49, 0xC7, 0x87); // mov qword [r15 + nops], nops
+      jit.imm32(static_cast<unsigned int>(station + offsetof(ALURetire, nops)));
+      jit.imm32(elided ? 0U : ins.nops);
+      if ((true == elided) || (0U == ins.code))
+       {
+         return;
+       }
+
+      jitBelt(jit, ins.a);
+      jit.op(0x48, 0xB9); // mov rcx, TRANSIENT | INVALID
+      jit.imm64(TRANSIENT | INVALID);
+      jit.op(0x48, 0x85, 0xC8); // test rax, rcx
+      jit.op(0x75); // jnz store
+      size_t store = jit.rel8();
+      switch (ins.code)
+       {
+         case 22: // getAdd(op1, imm, 0)
+         case 23: // getAdd(op1, ~imm, CARRY) ^ CARRY
+          {
+            jit.op(0x89, 0xC2); // mov edx, eax
+            jit.op(0xB9); // mov ecx, op2
+            jit.imm32((22U == ins.code) ? ins.imm : ~ins.imm);
+            jit.op(0x48, 0x89, 0xD0); // mov rax, rdx
+            jit.op(0x48, 0x01, 0xC8); // add rax, rcx
+            if (23U == ins.code)
+             {
+               jit.op(0x48, 0x83, 0xC0); // add rax, 1
+               jit.op(0x01);
+             }
+            jit.op(0x89, 0xC6); // mov esi, eax
+            jit.op(0x31, 0xD6); // xor esi, edx
+            jit.op(0x89, 0xC7); // mov edi, eax
+            jit.op(0x31, 0xCF); // xor edi, ecx
+            jit.op(0x21, 0xFE); // and esi, edi
+            jit.op(0x79); // jns no overflow
+            size_t noOverflow = jit.rel8();
+            jit.op(0x48, 0x0F, 0xBA); // bts rax, OVERFLOW
+            jit.op(0xE8, 35U);
+            jit.land8(noOverflow);
+            if (23U == ins.code)
+             {
+               jit.op(0x48, 0x0F, 0xBA); // btc rax, CARRY
+               jit.op(0xF8, 32U);
+             }
+          }
+            break;
+         case 29:
+            jit.op(0x25); // and eax, imm
+            jit.imm32(ins.imm);
+            break;
+         case 30:
+            jit.op(0x0D); // or eax, imm
+            jit.imm32(ins.imm);
+            break;
+         default:
+            jit.op(0x35); // xor eax, imm
+            jit.imm32(ins.imm);
+            break;
+       }
+      jit.op(0x85, 0xC0); // test eax, eax
+      jit.op(0x75); // jnz store
+      size_t nonZero = jit.rel8();
+      jit.op(0x48, 0x0F, 0xBA); // bts rax, ZERO
+      jit.op(0xE8, 36U);
+      jit.land8(store);
+      jit.land8(nonZero);
+      jit.op(0x49, 0x89, 0x87); // mov [r15 + dest], rax
+      jit.imm32(static_cast<unsigned int>(station + (ins.slow ? offsetof(ALURetire, slow) : offsetof(ALURetire, fast))));
+    }
+
+   // r8 = the word address in eax, and jump to the returned rel8 if it is outside of memory.
+   // Otherwise r9 = memory.
+   size_t jitWord(JitCode& jit)
+    {
+      jit.op(0x41, 0x89, 0xC0); // mov r8d, eax
+      jit.op(0x41, 0xC1, 0xE8); // shr r8d, 2
+      jit.op(0x02);
+      jit.op(0x48, 0xBE); // mov rsi, &memsize
+      jit.imm64(reinterpret_cast<size_t>(&machine->memsize));
+      jit.op(0x4C, 0x3B, 0x06); // cmp r8, [rsi]
+      jit.op(0x73); // jae outside
+      size_t outside = jit.rel8();
+      jit.op(0x48, 0xBE); // mov rsi, &memory
+      jit.imm64(reinterpret_cast<size_t>(&machine->memory));
+      jit.op(0x4C, 0x8B, 0x0E); // mov r9, [rsi]
+      return outside;
+    }
+
+   // Unconditional ldb and stb are done in line, except for the paths that report an error.
+   void jitFlowSlot(JitCode& jit, const FlowDecoded& ins, size_t slot, size_t flowpc)
+    {
+      const size_t station = flowStation(slot);
+      if (false == jitInlineFlow(ins))
+       {
+         jitFlowCall(jit, ins, slot);
+         return;
+       }
+
+      // FlowRetire::flush, when nothing but the first words were used.
+      jit.op(0x48, 0xB9); // mov rcx, EMPTY
+      jit.imm64(EMPTY);
+      jit.op(0x49, 0x39, 0x8F); // cmp [r15 + fast + 8], rcx
+      jit.imm32(static_cast<unsigned int>(station + offsetof(FlowRetire, fast) + sizeof(BELT_T)));
+      jit.op(0x75); // jne full
+      size_t full1 = jit.rel8();
+      jit.op(0x49, 0x39, 0x8F); // cmp [r15 + belt], rcx
+      jit.imm32(static_cast<unsigned int>(station + offsetof(FlowRetire, belt)));
+      jit.op(0x75); // jne full
+      size_t full2 = jit.rel8();
+      jit.op(0x41, 0x83, 0xBF); // cmp dword [r15 + use], NOT_IN_USE
+      jit.imm32(static_cast<unsigned int>(station + offsetof(FlowRetire, use)));
+      jit.op(static_cast<unsigned char>(NOT_IN_USE));
+      jit.op(0x74); // je flushed
+      size_t flushed = jit.rel8();
+      jit.land8(full1);
+      jit.land8(full2);
+      jit.op(0x49, 0x8D, 0xBF); // lea rdi, [r15 + station]
+      jit.imm32(static_cast<unsigned int>(station));
+      jitCall(jit, reinterpret_cast<const void*>(&jitFlush));
+      jit.op(0x48, 0xB9); // mov rcx, EMPTY
+      jit.imm64(EMPTY);
+      jit.land8(flushed);
+      jit.op(0x49, 0x89, 0x8F); // mov [r15 + fast], rcx
+      jit.imm32(static_cast<unsigned int>(station + offsetof(FlowRetire, fast)));
+      jit.op(0x49, 0x89, 0x8F); // mov [r15 + slow], rcx
+      jit.imm32(static_cast<unsigned int>(station + offsetof(FlowRetire, slow)));
+      const bool elided = (UNDECODED == ins.code);
+      const size_t fields [3] = { offsetof(FlowRetire, nops), offsetof(FlowRetire, next), offsetof(FlowRetire, jump) };
+      const unsigned int values [3] = { elided ? 0U : ins.nops, elided ? 0U : static_cast<unsigned int>(ins.next), 0U };
+      for (size_t i = 0U; i < 3U; ++i)
+       {
+         jit.op(0x49, 0xC7, 0x87); // mov qword [r15 + field], value
+         jit.imm32(static_cast<unsigned int>(station + fields[i]));
+         jit.imm32(values[i]);
+       }
+
+      if (4U == ins.code) // ldb
+       {
+         jitBelt(jit, ins.a);
+         jit.op(0x48, 0xB9); // mov rcx, TRANSIENT | INVALID
+         jit.imm64(TRANSIENT | INVALID);
+         jit.op(0x48, 0x85, 0xC8); // test rax, rcx
+         jit.op(0x0F, 0x85); // jnz store
+         size_t store = jit.rel32();
+         jit.op(0x89, 0xC1); // mov ecx, eax
+         jit.op(0x83, 0xE1, 0x03); // and ecx, 3
+         jit.op(0xC1, 0xE1, 0x03); // shl ecx, 3
+         size_t outside = jitWord(jit);
+         jit.op(0x43, 0x8B, 0x04); // mov eax, [r9 + r8 * 4]
+         jit.op(0x81);
+         jit.op(0xD3, 0xE8); // shr eax, cl
+         jit.op(0x0F, 0xBE, 0xC0); // movsx eax, al
+         jit.op(0x85, 0xC0); // test eax, eax
+         jit.op(0x75); // jnz store
+         size_t nonZero = jit.rel8();
+         jit.op(0x48, 0x0F, 0xBA); // bts rax, ZERO
+         jit.op(0xE8, 36U);
+         jit.op(0xEB); // jmp store
+         size_t zero = jit.rel8();
+         jit.land8(outside);
+         jit.op(0x48, 0xB8); // mov rax, INVALID | flowpc
+         jit.imm64(INVALID | static_cast<BELT_T>(flowpc));
+         jit.land32(store);
+         jit.land8(nonZero);
+         jit.land8(zero);
+         jit.op(0x49, 0x89, 0x87); // mov [r15 + dest], rax
+         jit.imm32(static_cast<unsigned int>(station + (ins.slow ? offsetof(FlowRetire, slow) : offsetof(FlowRetire, fast))));
+       }
+      else if (7U == ins.code) // stb
+       {
+         jitBelt(jit, ins.a);
+         jit.op(0x49, 0x89, 0xC2); // mov r10, rax
+         jitBelt(jit, ins.b);
+         jit.op(0x48, 0x89, 0xC2); // mov rdx, rax
+         jit.op(0x4C, 0x09, 0xD0); // or rax, r10
+         jit.op(0x48, 0xB9); // mov rcx, TRANSIENT
+         jit.imm64(TRANSIENT);
+         jit.op(0x48, 0x85, 0xC8); // test rax, rcx
+         jit.op(0x0F, 0x85); // jnz done : a transient operand suppresses the store
+         size_t transient = jit.rel32();
+         jit.op(0x48, 0xB9); // mov rcx, INVALID
+         jit.imm64(INVALID);
+         jit.op(0x48, 0x85, 0xC8); // test rax, rcx
+         jit.op(0x75); // jnz report
+         size_t invalid = jit.rel8();
+         jit.op(0x44, 0x89, 0xD0); // mov eax, r10d
+         size_t outside = jitWord(jit);
+         jit.op(0x43, 0x8B, 0x04); // mov eax, [r9 + r8 * 4]
+         jit.op(0x81);
+         jit.op(0x44, 0x89, 0xD1); // mov ecx, r10d
+         jit.op(0x83, 0xE1, 0x03); // and ecx, 3
+         jit.op(0xC1, 0xE1, 0x03); // shl ecx, 3
+         jit.op(0xBF); // mov edi, 0xFF
+         jit.imm32(0xFFU);
+         jit.op(0xD3, 0xE7); // shl edi, cl
+         jit.op(0xF7, 0xD7); // not edi
+         jit.op(0x21, 0xF8); // and eax, edi
+         jit.op(0x0F, 0xB6, 0xD2); // movzx edx, dl
+         jit.op(0xD3, 0xE2); // shl edx, cl
+         jit.op(0x09, 0xD0); // or eax, edx
+         jit.op(0x48, 0xBF); // mov rdi, machine
+         jit.imm64(reinterpret_cast<size_t>(machine));
+         jit.op(0x4C, 0x89, 0xC6); // mov rsi, r8
+         jit.op(0x89, 0xC2); // mov edx, eax
+         jitCall(jit, reinterpret_cast<const void*>(&jitStore));
+         jit.op(0xEB); // jmp done
+         size_t done = jit.rel8();
+         jit.land8(invalid);
+         jit.land8(outside);
+         jitFlowCall(jit, ins, slot); // Let the interpreter report it.
+         jit.land32(transient);
+         jit.land8(done);
+       }
+    }
+
+   static void jitFlowCall(JitCode& jit, const FlowDecoded& ins, size_t slot)
+    {
+      jit.op(0x49, 0x8D, 0xBE); // lea rdi, [r14 + slot]
+      jit.imm32(static_cast<unsigned int>(slot * sizeof(FlowUnit)));
+      jit.op(0x48, 0x89, 0xDE); // mov rsi, rbx
+      jit.op(0x48, 0xBA); // mov rdx, ins
+      jit.imm64(reinterpret_cast<size_t>(&ins));
+      jitCall(jit, reinterpret_cast<const void*>(&jitFlow));
+    }
+
+   // Compile a trace, cycle by cycle, as runTrace would run it. Returns NULL if it can't be mapped.
+   // A cycle made only of what is done in line also retires in line: nothing in it can branch,
+   // and only a store can stop the core or touch a trace, so only then (or under -limit) is the Machine checked.
+   template <size_t ALUS>
+   JitCode* compile(const Trace& trace)
+    {
+      JitCode* jit = new JitCode();
+      jit->op(0x53); // push rbx
+      jit->op(0x41, 0x54); // push r12
+      jit->op(0x41, 0x55); // push r13
+      jit->op(0x41, 0x56); // push r14
+      jit->op(0x41, 0x57); // push r15
+      jit->op(0x49, 0x89, 0xFC); // mov r12, rdi : core
+      jit->op(0x48, 0x89, 0xF3); // mov rbx, rsi : frame
+      jit->op(0x49, 0x89, 0xD5); // mov r13, rdx : aunits
+      jit->op(0x49, 0x89, 0xCE); // mov r14, rcx : funits
+      jit->op(0x49, 0xBF); // mov r15, the retire stations
+      jit->imm64(reinterpret_cast<size_t>(machine->alu_retire));
+      std::vector<size_t> exits;
+      for (size_t c = 0U; c < trace.cycles.size(); ++c)
+       {
+         const TraceCycle& cycle = trace.cycles[c];
+         const ALUDecoded* alu = &trace.alu[c * ALUS];
+         bool native = true;
+         for (size_t i = 0U; i < ALUS; ++i)
+          {
+            jitALUSlot(*jit, alu[i], i);
+            native = native && jitInlineALU(alu[i]);
+          }
+         bool stores = false;
+         for (size_t i = 0U; i < FLOW_UNITS; ++i)
+          {
+            jitFlowSlot(*jit, cycle.flow[i], i, cycle.before.flowpc);
+            native = native && jitInlineFlow(cycle.flow[i]);
+            stores = stores || (7U == cycle.flow[i].code);
+          }
+         const size_t after [4] = { cycle.after.alupc, cycle.after.flowpc, cycle.after.alunop, cycle.after.flownop };
+         const size_t fields [4] = { offsetof(Frame, alupc), offsetof(Frame, flowpc), offsetof(Frame, alunop), offsetof(Frame, flownop) };
+         for (size_t i = 0U; i < 4U; ++i)
+          {
+            jit->op(0x48, 0xB8); // mov rax, value
+            jit->imm64(after[i]);
+            jit->op(0x48, 0x89, 0x83); // mov [rbx + field], rax
+            jit->imm32(static_cast<unsigned int>(fields[i]));
+          }
+         if (true == native)
+          {
+            jit->op(0x48, 0xB8); // mov rax, &cycles
+            jit->imm64(reinterpret_cast<size_t>(&cycles));
+            jit->op(0x48, 0xFF, 0x00); // inc qword [rax]
+            for (size_t i = 0U; i < ALUS; ++i)
+             {
+               const ALUDecoded& ins = alu[i];
+               if ((UNDECODED != ins.code) && (0U != ins.code))
+                {
+                  jitRetireValue(*jit, aluStation(i) +
+                     (ins.slow ? offsetof(ALURetire, slow) : offsetof(ALURetire, fast)), 0U != ins.slow);
+                }
+             }
+            for (size_t i = 0U; i < FLOW_UNITS; ++i)
+             {
+               const FlowDecoded& ins = cycle.flow[i];
+               if (4U == ins.code)
+                {
+                  jitRetireValue(*jit, flowStation(i) +
+                     (ins.slow ? offsetof(FlowRetire, slow) : offsetof(FlowRetire, fast)), 0U != ins.slow);
+                }
+             }
+            size_t under = 0U;
+            if (false == stores)
+             {
+               if (0U == until)
+                {
+                  continue;
+                }
+               jit->op(0x48, 0xB8); // mov rax, &cycles : under -limit, the Machine is checked once it is reached
+               jit->imm64(reinterpret_cast<size_t>(&cycles));
+               jit->op(0x48, 0xB9); // mov rcx, &until
+               jit->imm64(reinterpret_cast<size_t>(&until));
+               jit->op(0x48, 0x8B, 0x09); // mov rcx, [rcx]
+               jit->op(0x48, 0x39, 0x08); // cmp [rax], rcx
+               jit->op(0x72); // jb under
+               under = jit->rel8();
+             }
+            jit->op(0x4C, 0x89, 0xE7); // mov rdi, r12
+            jitCall(*jit, reinterpret_cast<const void*>(&jitCheck));
+            if (0U != under)
+             {
+               jit->op(0x85, 0xC0); // test eax, eax
+               jit->op(0x0F, 0x85); // jnz exit
+               exits.push_back(jit->rel32());
+               jit->land8(under);
+               continue;
+             }
+          }
+         else
+          {
+            jit->op(0x4C, 0x89, 0xE7); // mov rdi, r12
+            jitCall(*jit, reinterpret_cast<const void*>(&jitRetire<ALUS>));
+          }
+         jit->op(0x85, 0xC0); // test eax, eax
+         jit->op(0x0F, 0x85); // jnz exit
+         exits.push_back(jit->rel32());
+       }
+      jit->op(0x31, 0xC0); // xor eax, eax
+      for (size_t i = 0U; i < exits.size(); ++i)
+       {
+         jit->land32(exits[i]);
+       }
+      jit->op(0x41, 0x5F); // pop r15
+      jit->op(0x41, 0x5E); // pop r14
+      jit->op(0x41, 0x5D); // pop r13
+      jit->op(0x41, 0x5C); // pop r12
+      jit->op(0x5B); // pop rbx
+      jit->op(0xC3); // ret
+      if (false == jit->finish())
+       {
+         delete jit;
+         return NULL;
+       }
+      return jit;
+    }
+
+   // Returns true when the core should stop.
+   bool runNative(const JitCode& native, ALUnit* aunits, FlowUnit* funits)
+    {
+      JitEntry entry;
+      std::memcpy(static_cast<void*>(&entry), static_cast<const void*>(&native.code), sizeof(entry));
+      redirected = false;
+      return 2 == entry(this, &machine->frames.back(), aunits, funits);
+    }
+#endif
+
+   template <size_t ALUS>
+   void runTraced(ALUnit* aunits, FlowUnit* funits)
+    {
+      for (;;)
+       {
+         if (true == machine->tracesStale)
+          {
+            traces.flush();
+            std::fill(machine->traced.begin(), machine->traced.end(), 0U);
+            machine->tracesStale = false;
+          }
+         Trace* trace = traces.find(*machine, machine->frames.back());
+         bool done;
+         if (false == trace->cycles.empty())
+          {
+#ifdef MILL_JIT
+            if ((ENGINE_JIT == engine) && (NULL == trace->native) && (JIT_THRESHOLD == ++trace->entries))
+             {
+               trace->native = compile<ALUS>(*trace);
+             }
+            if (NULL != trace->native)
+             {
+               done = runNative(*trace->native, aunits, funits);
+             }
+            else
+#endif
+             {
+               done = runTrace<ALUS>(*trace, aunits, funits);
+             }
+          }
+         else
+          {
+            record();
+            for (size_t i = 0U; i < ALUS; ++i)
+             {
+               aunits[i].step();
+             }
+            for (size_t i = 0U; i < FLOW_UNITS; ++i)
+             {
+               funits[i].step();
+             }
+            done = endCycle<ALUS>();
+          }
+         if (true == done)
+          {
+            machine->terminate = true;
+            break;
+          }
+         tick();
+       }
+    }
+
+   template <size_t ALUS>
+   void runThreaded(ALUnit* aunits, FlowUnit* funits)
+    {
+      Synchronizer* synchronizer = Synchronizer::create(sync, ALUS + FLOW_UNITS + 1U);
+
+      for (size_t i = 0U; i < ALUS; ++i)
+       {
+         aunits[i].synchronizer = synchronizer;
+         pthread_create(&aunits[i].thread, NULL, runOne, reinterpret_cast<void*>(&aunits[i]));
+       }
+
+      for (size_t i = 0U; i < FLOW_UNITS; ++i)
+       {
+         funits[i].synchronizer = synchronizer;
+         pthread_create(&funits[i].thread, NULL, runOne, reinterpret_cast<void*>(&funits[i]));
+       }
+
+      for (;;)
+       {
+         record();
+         // Signal the start of the instruction cycle
+         synchronizer->wait();
+         // Wait for the end of this cycle.
+         synchronizer->wait();
+
+         if (true == endCycle<ALUS>())
+          {
+            machine->terminate = true;
+            synchronizer->wait();
+            break;
+          }
+         tick(); // The units are waiting for the next cycle.
+       }
+
+      for (size_t i = 0U; i < ALUS; ++i)
+       {
+         pthread_join(aunits[i].thread, NULL);
+       }
+      for (size_t i = 0U; i < FLOW_UNITS; ++i)
+       {
+         pthread_join(funits[i].thread, NULL);
+       }
+      delete synchronizer;
+    }
+
+   void doStuff()
+    {
+      machine->prepare();
+      if (NULL != servePath)
+       {
+         serve();
+         return;
+       }
+      until = (0U == limit) ? 0U : cycles + limit;
+      if (true == profiler.on)
+       {
+         profiler.start(cycles);
+       }
+      if (0U != recording)
+       {
+         recorder.start(recording);
+         machine->recorder = &recorder;
+         drops.recorder = &recorder;
+         if (ENGINE_JIT == engine)
+          {
+            engine = ENGINE_TRACE; // Compiled code retires cycles without telling anyone.
+          }
+       }
+      if (true == stopwatch.on)
+       {
+         stopwatch.start();
+       }
+      run();
+      if (true == stopwatch.on)
+       {
+         stopwatch.stop();
+       }
+      if (0U != recording)
+       {
+         recorder.write("MillULX.rec", cycles);
+       }
+      if (true == profiler.on)
+       {
+         profiler.stop();
+         profiler.sample(*machine, cycles); // The cycles since the last sample
+         profiler.write("MillULX.folded", "MillULX.prof");
+       }
+      checkpoint.wait();
+      if (NULL != corePath)
+       {
+         machine->save(corePath);
+       }
+#ifdef MILL_STATS
+      if (STATS_NONE != stats)
+       {
+         std::fflush(stdout);
+         machine->counters.print(stderr, STATS_JSON == stats);
+       }
+#endif
+      if (true == stopwatch.on)
+       {
+         std::fflush(stdout);
+         stopwatch.print(stderr, engine, cycles);
+       }
+    }
+
+   // Run the guest on the units, as engine says, with as many ALU slots as the machine's width.
+   void run()
+    {
+      if (4U == machine->width)
+       {
+         runWidth<4U>();
+       }
+      else if (8U == machine->width)
+       {
+         runWidth<8U>();
+       }
+      else
+       {
+         runWidth<2U>();
+       }
+    }
+
+   template <size_t ALUS>
+   void runWidth()
+    {
+      ALUnit aunits [ALUS];
+      FlowUnit funits [FLOW_UNITS];
+#ifdef MILL_STATS
+      drops.counters = &machine->counters;
+#endif
+
+      for (size_t i = 0U; i < ALUS; ++i)
+       {
+         aunits[i].machine = machine;
+         aunits[i].synchronizer = NULL;
+         aunits[i].slot = i;
+       }
+
+      for (size_t i = 0U; i < FLOW_UNITS; ++i)
+       {
+         funits[i].machine = machine;
+         funits[i].synchronizer = NULL;
+         funits[i].slot = i;
+       }
+
+      if (ENGINE_THREADED == engine)
+       {
+         runThreaded<ALUS>(aunits, funits);
+       }
+      else if ((ENGINE_TRACE == engine) || (ENGINE_JIT == engine))
+       {
+         runTraced<ALUS>(aunits, funits);
+       }
+      else
+       {
+         runInline<ALUS>(aunits, funits);
+       }
+    }
+
+   // -serve and -forkserver: run the guest up to the cycle in which it first asks for input, and
+   // keep it there. Then, for each connection to the Unix socket at servePath, run a job from that
+   // point with the connection as its input and output. A fork server forks a child for each job;
+   // otherwise the jobs take turns, and the machine goes back to the snapshot after each.
+   void serve()
+    {
+      const Engine jobs = engine;
+      engine = ENGINE_INLINE; // The only engine that can leave a cycle undone
+      machine->warming = true;
+      run();
+      machine->warming = false;
+      engine = jobs;
+      if (false == machine->warm)
+       {
+         std::printf("The image finished before it asked for input.\n");
+         machine->save("MillULX.core");
+         return;
+       }
+      machine->warm = false;
+      machine->terminate = false;
+      Snapshot snap;
+      sockaddr_un address;
+      std::memset(static_cast<void*>(&address), 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      std::strncpy(address.sun_path, servePath, sizeof(address.sun_path) - 1U);
+      const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+      unlink(servePath);
+      if ((false == machine->snapshot(snap)) || (-1 == listener) ||
+          (0 != bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address))) || (0 != listen(listener, 16)))
+       {
+         std::printf("Cannot serve on %s\n", servePath);
+         return;
+       }
+      const size_t warmed = cycles; // Each job starts from here
+      until = (0U == limit) ? 0U : warmed + limit; // So each job gets the whole budget, and the warm-up none of it
+      signal(SIGPIPE, SIG_IGN); // A job that goes away early shouldn't take the server with it.
+      std::printf("Serving on %s\n", servePath);
+      std::fflush(stdout);
+      for (;;)
+       {
+         const int job = accept(listener, NULL, NULL);
+         while (waitpid(-1, NULL, WNOHANG) > 0) { }
+         if (-1 == job)
+          {
+            continue;
+          }
+         pid_t child = -1;
+         if (true == serveForking)
+          {
+            child = fork();
+            if (0 == child)
+             {
+               close(listener);
+               dup2(job, 0);
+               dup2(job, 1);
+               close(job);
+               run();
+               std::fflush(stdout);
+               _exit(0);
+             }
+          }
+         if (child < 0) // Not forking, or the fork failed.
+          {
+            const int in = dup(0);
+            const int out = dup(1);
+            dup2(job, 0);
+            dup2(job, 1);
+            run();
+            std::fflush(stdout);
+            dup2(in, 0);
+            dup2(out, 1);
+            close(in);
+            close(out);
+            HostIO::discard(); // Nothing of one job's input may be left for the next.
+            machine->restore(snap);
+            cycles = warmed;
+          }
+         close(job);
+       }
+    }
+ };
+
+void HelloWorld (Machine& machine)
+ {
+   const size_t mem = 45U;
+   machine.allocate(mem);
+   machine.frames[0].init();
+
+   machine.memory[0] = 10; // Jump back to the begining.
+   machine.memory[1] = 9; // return from bottommost frame : quit
+   machine.memory[2] = 16 | (31 << 5); // putchar
+   machine.memory[3] = 13 | (2 << 20);
+   machine.memory[4] = 16 | (31 << 5) | (1 << 11); // putchar
+   machine.memory[5] = 13 | (2 << 20) | (3 << 30);
+   machine.memory[6] = 16 | (31 << 5) | (2 << 11); // putchar
+   machine.memory[7] = 13 | (2 << 20);
+   machine.memory[8] = 16 | (31 << 5) | (3 << 11); // putchar
+   machine.memory[9] = 13 | (2 << 20);
+   machine.memory[10] = 16 | (31 << 5) | (4 << 11); // putchar
+   machine.memory[11] = 13 | (2 << 20) | (3 << 30);
+   machine.memory[12] = 16 | (31 << 5) | (5 << 11); // putchar
+   machine.memory[13] = 13 | (2 << 20);
+   machine.memory[14] = 16 | (31 << 5) | (6 << 11); // putchar
+   machine.memory[15] = 13 | (2 << 20);
+   machine.memory[16] = 16 | (31 << 5) | (7 << 11); // putchar
+   machine.memory[17] = 13 | (2 << 20) | (3 << 30);
+   machine.memory[18] = 16 | (31 << 5) | (8 << 11); // putchar
+   machine.memory[19] = 13 | (2 << 20);
+   machine.memory[20] = 16 | (31 << 5) | (9 << 11); // putchar
+   machine.memory[21] = 13 | (2 << 20);
+   machine.memory[22] = 16 | (31 << 5) | (10 << 11); // putchar
+   machine.memory[23] = 13 | (2 << 20) | (3 << 30);
+   machine.memory[24] = 16 | (31 << 5) | (11 << 11); // putchar
+   machine.memory[25] = 13 | (2 << 20);
+   machine.memory[26] = 16 | (31 << 5) | (12 << 11); // putchar
+   machine.memory[27] = 13 | (2 << 20);
+   machine.memory[28] = 16 | (31 << 5) | (11 << 11); // putchar
+   machine.memory[29] = 13 | (2 << 20) | (3 << 30);
+   machine.memory[30] = 0; // nop
+   // PROGRAM ENTRY POINT
+   machine.memory[31] = 22 | (30 << 6) | ('H' << 12) | (5 << 29);
+   machine.memory[32] = 22 | (30 << 6) | ('e' << 12); // 1
+   machine.memory[33] = 22 | (30 << 6) | ('l' << 12);
+   machine.memory[34] = 22 | (30 << 6) | ('l' << 12); // 2
+   machine.memory[35] = 22 | (30 << 6) | ('o' << 12);
+   machine.memory[36] = 22 | (30 << 6) | (',' << 12); // 3
+   machine.memory[37] = 22 | (30 << 6) | (' ' << 12);
+   machine.memory[38] = 22 | (30 << 6) | ('W' << 12); // 4
+   machine.memory[39] = 22 | (30 << 6) | ('o' << 12);
+   machine.memory[40] = 22 | (30 << 6) | ('r' << 12); // 5
+   machine.memory[41] = 22 | (30 << 6) | ('l' << 12);
+   machine.memory[42] = 22 | (30 << 6) | ('d' << 12); // 6
+   machine.memory[43] = 22 | (30 << 6) | ('!' << 12);
+   machine.memory[44] = 22 | (30 << 6) | ('\n' << 12); // 7
+
+   machine.frames[0].alupc = 31;
+   machine.frames[0].flowpc = 31;
+   machine.frames[0].entryPoint = 31;
+ }
+
+class SyncBenchUnit
+ {
+public:
+   Synchronizer* synchronizer;
+   size_t cycles;
+   pthread_t thread;
+
+   static void * runMe(void * slot)
+    {
+      SyncBenchUnit* unit = reinterpret_cast<SyncBenchUnit*>(slot);
+      for (size_t i = 0U; i < unit->cycles; ++i)
+       {
+         unit->synchronizer->wait(); // Start of cycle
+         unit->synchronizer->wait(); // End of cycle
+       }
+      return NULL;
+    }
+ };
+
+// Time empty clock cycles of the threaded engine: the units and the core meet twice per cycle and do nothing else.
+void benchSynchronizers(size_t cycles)
+ {
+   static const SyncKind kinds [] = { SYNC_PTHREAD, SYNC_SPIN, SYNC_HYBRID };
+   for (size_t k = 0U; k < sizeof(kinds) / sizeof(kinds[0]); ++k)
+    {
+      Synchronizer* synchronizer = Synchronizer::create(kinds[k], DEFAULT_ALUNITS + FLOW_UNITS + 1U);
+      SyncBenchUnit units [DEFAULT_ALUNITS + FLOW_UNITS];
+      for (size_t i = 0U; i < DEFAULT_ALUNITS + FLOW_UNITS; ++i)
+       {
+         units[i].synchronizer = synchronizer;
+         units[i].cycles = cycles;
+         pthread_create(&units[i].thread, NULL, SyncBenchUnit::runMe, reinterpret_cast<void*>(&units[i]));
+       }
+
+      struct timespec start, stop;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (size_t i = 0U; i < cycles; ++i)
+       {
+         synchronizer->wait();
+         synchronizer->wait();
+       }
+      clock_gettime(CLOCK_MONOTONIC, &stop);
+
+      for (size_t i = 0U; i < DEFAULT_ALUNITS + FLOW_UNITS; ++i)
+       {
+         pthread_join(units[i].thread, NULL);
+       }
+      delete synchronizer;
+
+      double elapsed = (stop.tv_sec - start.tv_sec) * 1e9 + (stop.tv_nsec - start.tv_nsec);
+      std::printf("%-8s %lu cycles, %lu threads: %.1f ns/cycle\n", Synchronizer::name(kinds[k]),
+         static_cast<unsigned long>(cycles), static_cast<unsigned long>(DEFAULT_ALUNITS + FLOW_UNITS + 1U), elapsed / cycles);
+    }
+ }
+
+// Whether the engines are built for width ALU slots.
+static bool knownWidth(size_t width)
+ {
+   const size_t * const end = ALU_WIDTHS + sizeof(ALU_WIDTHS) / sizeof(ALU_WIDTHS[0]);
+   return std::find(ALU_WIDTHS, end, width) != end;
+ }
+
+// Open an image, and read its tag into mill. For all but MillImg2, also read the ALU width it was scheduled
+// for: the digit after the size of a size, or a space for DEFAULT_ALUNITS. Returns NULL (having said why)
+// if it can't be run.
+static std::FILE * openImage(const char * name, char * mill, size_t& width)
+ {
+   std::FILE * file = std::fopen(name, "rb");
+   if (NULL == file)
+    {
+      std::printf("Cannot open file %s\n", name);
+      return NULL;
+    }
+   std::fread(mill, 1U, 4U, file);
+   if (0 != std::strncmp(mill, "Mill", 4U))
+    {
+      std::printf("Not an image.\n");
+      std::fclose(file);
+      return NULL;
+    }
+   std::fread(mill, 1U, 4U, file);
+   if (0 == std::strncmp(mill, "Img2", 4U))
+    {
+      return file; // The same on every host.
+    }
+   if (0 != std::strncmp(mill, endian(), 2U))
+    {
+      std::printf("Only images of the same endianness as the host machine are supported.\n");
+      std::fclose(file);
+      return NULL;
+    }
+   if (sizeof(size_t) != (mill[2] - '0'))
+    { // Add a check so that I can't execute my desktop progs on my Pi3 and vice-versa.
+      std::printf("Image uses different size of a 'size' than is supported.\n");
+      std::fclose(file);
+      return NULL;
+    }
+   width = (' ' == mill[3]) ? DEFAULT_ALUNITS : static_cast<size_t>(mill[3] - '0');
+   if (false == knownWidth(width))
+    {
+      std::printf("Image is scheduled for %c ALU slots: this build runs 2, 4 or 8.\n", mill[3]);
+      std::fclose(file);
+      return NULL;
+    }
+   std::fread(mill, 1U, 4U, file);
+   return file;
+ }
+
+static unsigned long long readLE(std::FILE * file, size_t bytes)
+ {
+   unsigned char buffer [8U] = { 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U };
+   std::fread(buffer, 1U, bytes, file);
+   unsigned long long result = 0U;
+   for (size_t i = bytes; i > 0U; --i)
+    {
+      result = (result << 8) | buffer[i - 1U];
+    }
+   return result;
+ }
+
+// Image format 2. Every field is little-endian, whatever the host.
+// "MillImg2" version:32 num_sections:32 memory_size:64 entry_point:64
+//    { kind:32 reserved:32 address:64 size:64 offset:64 } {pad {data_word:32}}
+// Sizes and addresses are in words. A DATA section's words are at offset in the file, which is congruent
+// to its address modulo 4096 (so that they can be mapped); a ZERO section has nothing in the file.
+// A WIDTH section's address is the ALU width the image was scheduled for: without one, it is DEFAULT_ALUNITS.
+enum SectionKind
+ {
+   SECTION_DATA = 1,
+   SECTION_ZERO = 2,
+   SECTION_WIDTH = 3
+ };
+
+static const size_t SECTION_ENTRY = 32U; // Bytes a section takes in the table
+
+// With the file just past "MillImg2". Returns false (having said why) if the image can't be loaded.
+static bool loadImage2(Machine& machine, std::FILE * file)
+ {
+   const unsigned long long version = readLE(file, 4U);
+   const unsigned long long numSections = readLE(file, 4U);
+   const unsigned long long memsize = readLE(file, 8U);
+   const unsigned long long entry = readLE(file, 8U);
+   if ((2U != version) || (memsize > (~static_cast<size_t>(0U) / sizeof(MEM_T))))
+    {
+      std::printf("Image format not recognized.\n");
+      return false;
+    }
+   machine.allocate(static_cast<size_t>(memsize));
+   machine.frames[0].entryPoint = static_cast<size_t>(entry);
+   machine.frames[0].alupc = machine.frames[0].entryPoint;
+   machine.frames[0].flowpc = machine.frames[0].entryPoint;
+   for (unsigned long long i = 0U; i < numSections; ++i)
+    {
+      std::fseek(file, static_cast<long>(32U + i * SECTION_ENTRY), SEEK_SET);
+      const unsigned long long kind = readLE(file, 4U);
+      readLE(file, 4U);
+      const unsigned long long address = readLE(file, 8U);
+      const unsigned long long size = readLE(file, 8U);
+      const unsigned long long offset = readLE(file, 8U);
+      if (SECTION_WIDTH == kind)
+       {
+         if ((0U != size) || (false == knownWidth(static_cast<size_t>(address))))
+          {
+            std::printf("Image is scheduled for %llu ALU slots: this build runs 2, 4 or 8.\n", address);
+            return false;
+          }
+         machine.setWidth(static_cast<size_t>(address));
+         continue;
+       }
+      if ((address > memsize) || (size > memsize - address))
+       {
+         std::printf("Bad block in image.\n");
+         return false;
+       }
+      if (SECTION_ZERO == kind)
+       {
+         machine.zero(static_cast<size_t>(address), static_cast<size_t>(size));
+       }
+      else if ((SECTION_DATA != kind) ||
+         (false == machine.load(fileno(file), static_cast<size_t>(offset), static_cast<size_t>(address), static_cast<size_t>(size))))
+       {
+         std::printf("Bad block in image.\n");
+         return false;
+       }
+      else if (0 != std::strncmp("LE", endian(), 2U))
+       {
+         for (size_t j = 0U; j < size; ++j)
+          {
+            MEM_T& word = machine.memory[address + j];
+            word = (word >> 24) | ((word >> 8) & 0xFF00U) | ((word << 8) & 0xFF0000U) | (word << 24);
+          }
+       }
+    }
+   return true;
+ }
+
+// Rebuild the machine from a checkpoint chain: the Core stem.0, and then each delta up to stem.last.
+static bool restore(Machine& machine, const std::string& stem, size_t last)
+ {
+   Checkpoint chain;
+   chain.name = stem;
+   for (size_t n = 0U; n <= last; ++n)
+    {
+      char mill [4U];
+      size_t width = DEFAULT_ALUNITS;
+      std::FILE * file = openImage(chain.file(n).c_str(), mill, width);
+      if (NULL == file)
+       {
+         return false;
+       }
+      bool good = (0 == std::strncmp(mill, (0U == n) ? CORE_TAG : DELTA_TAG, 4U)) && ((0U == n) || (width == machine.width));
+      std::fread(mill, 1U, 4U, file);
+      if ((true == good) && (0U == n))
+       {
+         machine.setWidth(width);
+         good = machine.read(file, mill);
+       }
+      else if (true == good)
+       {
+         good = machine.readDelta(file, n);
+       }
+      std::fclose(file);
+      if (false == good)
+       {
+         std::printf("%s doesn't follow on from the checkpoint before it.\n", chain.file(n).c_str());
+         return false;
+       }
+    }
+   return true;
+ }
+
+// Load the image called name into machine (and, for the last link of a checkpoint chain, set up core to carry
+// the chain on). Returns false, having said why, if it can't be run.
+static bool loadImage(Machine& machine, MillCore& core, const char * name)
+ {
+   char mill [4U];
+   size_t width = DEFAULT_ALUNITS;
+   std::FILE * file = openImage(name, mill, width);
+   if (NULL == file)
+    {
+      return false;
+    }
+   machine.setWidth(width); // Img2 may say otherwise.
+   if (0 == std::strncmp(mill, "Img2", 4U))
+    {
+      const bool loaded = loadImage2(machine, file);
+      std::fclose(file);
+      if (false == loaded)
+       {
+         return false;
+       }
+    }
+// "Mill" "LE? " "Core" "    " memory_size {data_word} num_frames { frames }
+// "Mill" "LE? " "Core" "Page" memory_size {pad} {data_word} num_frames { frames }
+// "Mill" "LE? " "Core" "Pack" memory_size frame_bytes {chunk} : see Machine::writePacked
+   else if (0 == std::strncmp(mill, CORE_TAG, 4U))
+    {
+      std::fread(mill, 1U, 4U, file); // word-align the file
+      // A better way to do this is to create a Strategy that is accepted by the class so that
+      // knowledge of how to de/serialize a specific class hierarchy to a specific format is in one place.
+      const bool good = machine.read(file, mill);
+      std::fclose(file);
+      if (false == good)
+       {
+         std::printf("Core image is damaged.\n");
+         return false;
+       }
+    }
+// "Mill" "LE? " "Delt" "Page" sequence ... : the last link of a checkpoint chain, named stem.sequence
+   else if (0 == std::strncmp(mill, DELTA_TAG, 4U))
+    {
+      std::fread(mill, 1U, 4U, file);
+      size_t sequence = 0U;
+      std::fread(static_cast<void*>(&sequence), sizeof(size_t), 1U, file);
+      std::fclose(file);
+      std::string stem (name);
+      stem.erase(std::min(stem.size(), stem.rfind('.')));
+      if (false == restore(machine, stem, sequence))
+       {
+         return false;
+       }
+      if (0U != core.checkpoint.interval)
+       {
+         core.checkpoint.resume(stem, sequence);
+       }
+    }
+// "Mill" "LE? " "Prog" "    " memory_size entry_point num_blocks { block_entry block_size {data_word} }
+// "Mill" "LE? " "Prog" "Page" memory_size entry_point num_blocks { block_entry block_size {pad} {data_word} }
+   else if (0 == std::strncmp(mill, "Prog", 4U))
+    {
+      std::fread(mill, 1U, 4U, file); // word-align the file
+      const bool paged = (0 == std::strncmp(mill, "Page", 4U));
+      size_t memsize = 0U;
+      std::fread(static_cast<void*>(&memsize), sizeof(size_t), 1U, file);
+//      std::printf("Size: %lu\n", memsize);
+      machine.allocate(memsize);
+      std::fread(static_cast<void*>(&machine.frames[0].entryPoint), sizeof(size_t), 1U, file);
+//      std::printf("Entry Point: %lu\n", machine.frames[0].entryPoint);
+      machine.frames[0].alupc = machine.frames[0].entryPoint;
+      machine.frames[0].flowpc = machine.frames[0].entryPoint;
+      size_t numBlocks;
+      std::fread(static_cast<void*>(&numBlocks), sizeof(size_t), 1U, file);
+//      std::printf("Num Blocks: %lu\n", numBlocks);
+      while (numBlocks > 0U)
+       {
+         size_t blockEntry;
+         std::fread(static_cast<void*>(&blockEntry), sizeof(size_t), 1U, file);
+//         std::printf("Block Entry: %lu\n", blockEntry);
+         size_t blockSize;
+         std::fread(static_cast<void*>(&blockSize), sizeof(size_t), 1U, file);
+//         std::printf("Block Size: %lu\n", blockSize);
+         size_t offset = static_cast<size_t>(std::ftell(file));
+         if (true == paged)
           {
-            if (true == machine->invalidOp)
-             {
-               std::printf("Terminating Core due to invalid operation\n");
-             }
-            machine->terminate = true;
-            pthread_barrier_wait(&synchronizer);
-            break;
+            offset = imageAlign(offset, blockEntry);
+          }
+         if ((blockEntry > machine.memsize) || (blockSize > machine.memsize - blockEntry) ||
+             (false == machine.load(fileno(file), offset, blockEntry, blockSize)))
+          {
+            std::printf("Bad block in image.\n");
+            std::fclose(file);
+            return false;
           }
+         std::fseek(file, static_cast<long>(offset + blockSize * sizeof(MEM_T)), SEEK_SET);
+         --numBlocks;
        }
+      std::fclose(file);
+    }
+   else if ((0 == std::strncmp(mill, CORE_TAG, 2U)) || (0 == std::strncmp(mill, DELTA_TAG, 2U)))
+    {
+      std::printf("Image was saved by a build with another MILL_BELT_SIZE.\n");
+      std::fclose(file);
+      return false;
+    }
+   else
+    {
+      std::printf("Image format not recognized.\n");
+      std::fclose(file);
+      return false;
+    }
+   return true;
+ }
 
-      {
-         std::FILE * file = std::fopen("MillULX.core", "wb"); // Assume success
-         std::fprintf(file, "Mill%s%d Core    ", endian(), static_cast<int>(sizeof(size_t)));
-         machine->write(file); // As simple and elegant as this SEEMS, it is always a bad way to structure the code.
-         std::fclose(file);
-      }
+// One worker's share of the -batch jobs. The worker takes its own from the bottom, and a worker with none left
+// steals from the top of another's. A Chase-Lev deque, but as every job is dealt before the workers start, no one
+// ever pushes: the array doesn't grow, and bottom only goes down.
+class JobDeque
+ {
+public:
+   std::vector<size_t> jobs;
+   std::atomic<long> top;
+   std::atomic<long> bottom;
 
-      for (size_t i = 0U; i < ALUNITS; ++i)
+   JobDeque() : top(0L), bottom(0L) { }
+
+   // Before the workers start.
+   void deal(size_t job)
+    {
+      jobs.push_back(job);
+      bottom.store(static_cast<long>(jobs.size()), std::memory_order_relaxed);
+    }
+
+   // By the owner.
+   bool take(size_t& job)
+    {
+      const long b = bottom.load(std::memory_order_relaxed) - 1L;
+      bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      long t = top.load(std::memory_order_relaxed);
+      if (t > b)
        {
-         pthread_join(aunits[i].thread, NULL);
+         bottom.store(b + 1L, std::memory_order_relaxed);
+         return false;
        }
-      for (size_t i = 0U; i < FLOW_UNITS; ++i)
+      job = jobs[static_cast<size_t>(b)];
+      if (t == b) // The last one: race the thieves for it.
        {
-         pthread_join(funits[i].thread, NULL);
+         const bool won = top.compare_exchange_strong(t, t + 1L, std::memory_order_seq_cst, std::memory_order_relaxed);
+         bottom.store(b + 1L, std::memory_order_relaxed);
+         return won;
+       }
+      return true;
+    }
+
+   // By anyone else. Also false when another thief, or the owner, got there first.
+   bool steal(size_t& job)
+    {
+      long t = top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const long b = bottom.load(std::memory_order_acquire);
+      if (t >= b)
+       {
+         return false;
        }
+      job = jobs[static_cast<size_t>(t)];
+      return top.compare_exchange_strong(t, t + 1L, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+   bool empty() const
+    {
+      return top.load(std::memory_order_acquire) >= bottom.load(std::memory_order_acquire);
     }
  };
 
-void HelloWorld (Machine& machine)
+// -batch=manifest: run each job the manifest lists, each on a machine of its own, a machine to a worker
+// at a time. A job is a line of the manifest: the image, the file that is its input (- for none), and the
+// file its output goes to. Nothing is shared between the jobs but the image files.
+class Batch
  {
-   const size_t mem = 45U;
-   machine.memory = new MEM_T[mem];
-   machine.memsize = mem;
-   machine.frames[0].init();
+public:
+   struct Job
+    {
+      std::string image;
+      std::string input;
+      std::string output;
+      bool good;
+    };
 
-   machine.memory[0] = 10; // Jump back to the begining.
-   machine.memory[1] = 9; // return from bottommost frame : quit
-   machine.memory[2] = 16 | (31 << 5); // putchar
-   machine.memory[3] = 13 | (2 << 20);
-   machine.memory[4] = 16 | (31 << 5) | (1 << 11); // putchar
-   machine.memory[5] = 13 | (2 << 20) | (3 << 30);
-   machine.memory[6] = 16 | (31 << 5) | (2 << 11); // putchar
-   machine.memory[7] = 13 | (2 << 20);
-   machine.memory[8] = 16 | (31 << 5) | (3 << 11); // putchar
-   machine.memory[9] = 13 | (2 << 20);
-   machine.memory[10] = 16 | (31 << 5) | (4 << 11); // putchar
-   machine.memory[11] = 13 | (2 << 20) | (3 << 30);
-   machine.memory[12] = 16 | (31 << 5) | (5 << 11); // putchar
-   machine.memory[13] = 13 | (2 << 20);
-   machine.memory[14] = 16 | (31 << 5) | (6 << 11); // putchar
-   machine.memory[15] = 13 | (2 << 20);
-   machine.memory[16] = 16 | (31 << 5) | (7 << 11); // putchar
-   machine.memory[17] = 13 | (2 << 20) | (3 << 30);
-   machine.memory[18] = 16 | (31 << 5) | (8 << 11); // putchar
-   machine.memory[19] = 13 | (2 << 20);
-   machine.memory[20] = 16 | (31 << 5) | (9 << 11); // putchar
-   machine.memory[21] = 13 | (2 << 20);
-   machine.memory[22] = 16 | (31 << 5) | (10 << 11); // putchar
-   machine.memory[23] = 13 | (2 << 20) | (3 << 30);
-   machine.memory[24] = 16 | (31 << 5) | (11 << 11); // putchar
-   machine.memory[25] = 13 | (2 << 20);
-   machine.memory[26] = 16 | (31 << 5) | (12 << 11); // putchar
-   machine.memory[27] = 13 | (2 << 20);
-   machine.memory[28] = 16 | (31 << 5) | (11 << 11); // putchar
-   machine.memory[29] = 13 | (2 << 20) | (3 << 30);
-   machine.memory[30] = 0; // nop
-   // PROGRAM ENTRY POINT
-   machine.memory[31] = 22 | (30 << 6) | ('H' << 12) | (5 << 29);
-   machine.memory[32] = 22 | (30 << 6) | ('e' << 12); // 1
-   machine.memory[33] = 22 | (30 << 6) | ('l' << 12);
-   machine.memory[34] = 22 | (30 << 6) | ('l' << 12); // 2
-   machine.memory[35] = 22 | (30 << 6) | ('o' << 12);
-   machine.memory[36] = 22 | (30 << 6) | (',' << 12); // 3
-   machine.memory[37] = 22 | (30 << 6) | (' ' << 12);
-   machine.memory[38] = 22 | (30 << 6) | ('W' << 12); // 4
-   machine.memory[39] = 22 | (30 << 6) | ('o' << 12);
-   machine.memory[40] = 22 | (30 << 6) | ('r' << 12); // 5
-   machine.memory[41] = 22 | (30 << 6) | ('l' << 12);
-   machine.memory[42] = 22 | (30 << 6) | ('d' << 12); // 6
-   machine.memory[43] = 22 | (30 << 6) | ('!' << 12);
-   machine.memory[44] = 22 | (30 << 6) | ('\n' << 12); // 7
+   struct Worker
+    {
+      Batch* batch;
+      size_t self;
+      pthread_t thread;
+    };
 
-   machine.frames[0].alupc = 31;
-   machine.frames[0].flowpc = 31;
-   machine.frames[0].entryPoint = 31;
- }
+   std::vector<Job> jobs;
+   JobDeque* deques; // One to a worker
+   size_t workers;
+   Engine engine;
+   SyncKind sync;
+   size_t limit;
+
+   Batch() : deques(NULL), workers(0U), engine(ENGINE_TRACE), sync(SYNC_HYBRID), limit(0U) { }
+
+   // Returns false, having said why, if the manifest can't be read.
+   bool read(const char * manifest)
+    {
+      std::FILE * file = std::fopen(manifest, "r");
+      if (NULL == file)
+       {
+         std::printf("Cannot read %s\n", manifest);
+         return false;
+       }
+      char line [4096U];
+      size_t number = 0U;
+      bool good = true;
+      while ((true == good) && (NULL != std::fgets(line, sizeof(line), file)))
+       {
+         ++number;
+         const char * fields [3U];
+         size_t count = 0U;
+         char * field = std::strtok(line, " \t\r\n");
+         for (; (NULL != field) && (count < 3U); ++count)
+          {
+            fields[count] = field;
+            field = std::strtok(NULL, " \t\r\n");
+          }
+         if ((0U == count) || ('#' == fields[0][0]))
+          {
+            continue; // Blank, or a comment
+          }
+         if ((3U != count) || (NULL != field))
+          {
+            std::printf("%s:%lu: a job is an image, an input and an output\n", manifest, static_cast<unsigned long>(number));
+            good = false;
+          }
+         else
+          {
+            Job job;
+            job.image = fields[0];
+            job.input = fields[1];
+            job.output = fields[2];
+            job.good = false;
+            jobs.push_back(job);
+          }
+       }
+      std::fclose(file);
+      return good;
+    }
+
+   // On as many workers, and no more than there are jobs. Returns how many jobs failed.
+   size_t run(size_t count)
+    {
+      workers = std::max(static_cast<size_t>(1U), std::min(count, jobs.size()));
+      if (ENGINE_THREADED == engine)
+       {
+         std::printf("-batch runs a machine to a worker: using -trace\n");
+         engine = ENGINE_TRACE;
+       }
+      deques = new JobDeque [workers];
+      for (size_t i = 0U; i < jobs.size(); ++i)
+       {
+         deques[i % workers].deal(i);
+       }
+      std::vector<Worker> pool (workers);
+      for (size_t i = 0U; i < workers; ++i)
+       {
+         pool[i].batch = this;
+         pool[i].self = i;
+         pthread_create(&pool[i].thread, NULL, runWorker, reinterpret_cast<void*>(&pool[i]));
+       }
+      for (size_t i = 0U; i < workers; ++i)
+       {
+         pthread_join(pool[i].thread, NULL);
+       }
+      delete [] deques;
+      deques = NULL;
+      size_t failed = 0U;
+      for (size_t i = 0U; i < jobs.size(); ++i)
+       {
+         if (false == jobs[i].good)
+          {
+            ++failed;
+          }
+       }
+      return failed;
+    }
+
+   static void * runWorker(void * slot)
+    {
+      Worker* worker = reinterpret_cast<Worker*>(slot);
+      worker->batch->work(worker->self);
+      return NULL;
+    }
+
+   void work(size_t self)
+    {
+      size_t job;
+      for (;;)
+       {
+         if (true == deques[self].take(job))
+          {
+            runJob(jobs[job]);
+            continue;
+          }
+         bool stole = false;
+         bool left = false;
+         for (size_t i = 1U; (false == stole) && (i < workers); ++i)
+          {
+            JobDeque& victim = deques[(self + i) % workers];
+            stole = victim.steal(job);
+            left = left || (false == victim.empty());
+          }
+         if (true == stole)
+          {
+            runJob(jobs[job]);
+          }
+         else if (false == left)
+          {
+            return; // Every job has been taken, and the workers that took them will see them through.
+          }
+         else
+          {
+            sched_yield(); // Lost a race for the last of someone's jobs
+          }
+       }
+    }
+
+   void runJob(Job& job)
+    {
+      JobIO io;
+      if ((job.input != "-") && (false == slurp(job.input.c_str(), io.input)))
+       {
+         std::printf("Cannot read %s\n", job.input.c_str());
+         return;
+       }
+      Machine machine;
+      machine.job = &io;
+      MillCore core;
+      core.machine = &machine;
+      core.engine = engine;
+      core.sync = sync;
+      core.limit = limit;
+      core.corePath = NULL; // Each job's machine is thrown away.
+      if (false == loadImage(machine, core, job.image.c_str()))
+       {
+         return;
+       }
+      core.doStuff();
+      std::FILE * file = std::fopen(job.output.c_str(), "wb");
+      if ((NULL == file) || (io.output.size() != std::fwrite(io.output.data(), 1U, io.output.size(), file)))
+       {
+         std::printf("Cannot write %s\n", job.output.c_str());
+       }
+      else
+       {
+         job.good = (false == machine.invalidOp);
+       }
+      if (NULL != file)
+       {
+         std::fclose(file);
+       }
+    }
+
+   static bool slurp(const char * name, std::vector<unsigned char>& into)
+    {
+      std::FILE * file = std::fopen(name, "rb");
+      if (NULL == file)
+       {
+         return false;
+       }
+      unsigned char buffer [65536U];
+      size_t got;
+      while (0U != (got = std::fread(buffer, 1U, sizeof(buffer), file)))
+       {
+         into.insert(into.end(), buffer, buffer + got);
+       }
+      std::fclose(file);
+      return true;
+    }
+ };
 
 int main (int argc, char ** argv)
  {
+   HostIO::init();
    Machine machine;
    MillCore core;
    core.machine = &machine;
+   const char * manifest = NULL;
+   size_t workers = static_cast<size_t>(std::max(1L, sysconf(_SC_NPROCESSORS_ONLN)));
 
-   if (1 == argc)
-    {
-      HelloWorld(machine);
-      core.doStuff();
-    }
-   else
+   int arg = 1;
+   for (; (arg < argc) && ('-' == argv[arg][0]); ++arg)
     {
-      std::FILE * file = std::fopen(argv[1], "rb");
-      if (NULL == file)
+      if (0 == std::strcmp(argv[arg], "-inline"))
        {
-         std::printf("Cannot open file %s\n", argv[1]);
-         return 1;
+         core.engine = ENGINE_INLINE;
        }
-      char mill [4U];
-      std::fread(mill, 1U, 4U, file);
-      if (0 != std::strncmp(mill, "Mill", 4U))
+      else if (0 == std::strcmp(argv[arg], "-threaded"))
        {
-         std::printf("Not an image.\n");
-         std::fclose(file);
-         return 1;
+         core.engine = ENGINE_THREADED;
        }
-      std::fread(mill, 1U, 4U, file);
-      if (0 != std::strncmp(mill, endian(), 2U))
+      else if (0 == std::strcmp(argv[arg], "-trace"))
        {
-         std::printf("Only images of the same endianness as the host machine are supported.\n");
-         std::fclose(file);
-         return 1;
+         core.engine = ENGINE_TRACE;
        }
-      if (sizeof(size_t) != (mill[2] - '0'))
-       { // Add a check so that I can't execute my desktop progs on my Pi3 and vice-versa.
-         std::printf("Image uses different size of a 'size' than is supported.\n");
-         std::fclose(file);
-         return 1;
+      else if (0 == std::strcmp(argv[arg], "-jit"))
+       {
+#ifdef MILL_JIT
+         core.engine = ENGINE_JIT;
+#else
+         std::printf("No JIT in this build: using -trace\n");
+         core.engine = ENGINE_TRACE;
+#endif
        }
-      std::fread(mill, 1U, 4U, file);
-// "Mill" "LE? " "Core" "    " memory_size {data_word} num_frames { frames }
-      if (0 == std::strncmp(mill, "Core", 4U))
+      else if (0 == std::strcmp(argv[arg], "-sync=pthread"))
        {
-         std::fread(mill, 1U, 4U, file); // word-align the file
-         // A better way to do this is to create a Strategy that is accepted by the class so that
-         // knowledge of how to de/serialize a specific class hierarchy to a specific format is in one place.
-         machine.read(file);
-         std::fclose(file);
-         core.doStuff();
+         core.sync = SYNC_PTHREAD;
        }
-// "Mill" "LE? " "Prog" "    " memory_size entry_point num_blocks { block_entry block_size {data_word} }
-      else if (0 == std::strncmp(mill, "Prog", 4U))
-       {
-         std::fread(mill, 1U, 4U, file); // word-align the file
-         std::fread(static_cast<void*>(&machine.memsize), sizeof(size_t), 1U, file);
-//         std::printf("Size: %lu\n", machine.memsize);
-         machine.memory = new MEM_T [machine.memsize];
-         std::fread(static_cast<void*>(&machine.frames[0].entryPoint), sizeof(size_t), 1U, file);
-//         std::printf("Entry Point: %lu\n", machine.frames[0].entryPoint);
-         machine.frames[0].alupc = machine.frames[0].entryPoint;
-         machine.frames[0].flowpc = machine.frames[0].entryPoint;
-         size_t numBlocks;
-         std::fread(static_cast<void*>(&numBlocks), sizeof(size_t), 1U, file);
-//         std::printf("Num Blocks: %lu\n", numBlocks);
-         while (numBlocks > 0U)
-          {
-            size_t blockEntry;
-            std::fread(static_cast<void*>(&blockEntry), sizeof(size_t), 1U, file);
-//            std::printf("Block Entry: %lu\n", blockEntry);
-            size_t blockSize;
-            std::fread(static_cast<void*>(&blockSize), sizeof(size_t), 1U, file);
-//            std::printf("Block Size: %lu\n", blockSize);
-            std::fread(static_cast<void*>(machine.memory + blockEntry), sizeof(MEM_T), blockSize, file);
-            --numBlocks;
+      else if (0 == std::strcmp(argv[arg], "-sync=spin"))
+       {
+         core.sync = SYNC_SPIN;
+       }
+      else if (0 == std::strcmp(argv[arg], "-sync=hybrid"))
+       {
+         core.sync = SYNC_HYBRID;
+       }
+      else if (0 == std::strcmp(argv[arg], "-core=page"))
+       {
+         machine.packCores = false;
+       }
+      else if (0 == std::strcmp(argv[arg], "-core=pack"))
+       {
+         machine.packCores = true;
+       }
+      else if (0 == std::strncmp(argv[arg], "-serve=", 7U))
+       {
+         core.servePath = argv[arg] + 7;
+         core.serveForking = false;
+       }
+      else if (0 == std::strncmp(argv[arg], "-forkserver=", 12U))
+       {
+         core.servePath = argv[arg] + 12;
+         core.serveForking = true;
+       }
+      else if ((0 == std::strcmp(argv[arg], "-stats")) || (0 == std::strcmp(argv[arg], "-stats=json")))
+       {
+#ifdef MILL_STATS
+         core.stats = ('=' == argv[arg][6]) ? STATS_JSON : STATS_TEXT;
+#else
+         std::printf("Built without MILL_STATS: there are no counters\n");
+#endif
+       }
+      else if (0 == std::strncmp(argv[arg], "-profile", 8U))
+       {
+         core.profiler.on = true;
+         core.profiler.interval = ('=' != argv[arg][8]) ? 1000U :
+            ((0 == std::strcmp(argv[arg] + 9, "timer")) ? 0U : std::strtoul(argv[arg] + 9, NULL, 10));
+       }
+      else if (0 == std::strncmp(argv[arg], "-record", 7U))
+       {
+         core.recording = ('=' == argv[arg][7]) ? std::strtoul(argv[arg] + 8, NULL, 10) : 65536U;
+       }
+      else if (0 == std::strncmp(argv[arg], "-limit=", 7U))
+       {
+         core.limit = std::strtoul(argv[arg] + 7, NULL, 10);
+       }
+      else if (0 == std::strcmp(argv[arg], "-bench"))
+       {
+         core.stopwatch.on = true;
+       }
+      else if (0 == std::strncmp(argv[arg], "-batch=", 7U))
+       {
+         manifest = argv[arg] + 7;
+       }
+      else if (0 == std::strncmp(argv[arg], "-workers=", 9U))
+       {
+         workers = std::strtoul(argv[arg] + 9, NULL, 10);
+       }
+      else if (0 == std::strncmp(argv[arg], "-input=", 7U))
+       {
+         if (NULL == std::freopen(argv[arg] + 7, "rb", stdin))
+          {
+            std::printf("Cannot read %s\n", argv[arg] + 7);
+            return 1;
           }
-         std::fclose(file);
-         core.doStuff();
+       }
+      else if (0 == std::strncmp(argv[arg], "-checkpoint=", 12U))
+       {
+         core.checkpoint.interval = std::strtoul(argv[arg] + 12, NULL, 10);
+         core.checkpoint.next = core.checkpoint.interval;
+         core.checkpoint.start(NULL);
+       }
+      else if (0 == std::strncmp(argv[arg], "-syncbench", 10U))
+       {
+         size_t cycles = ('=' == argv[arg][10]) ? std::strtoul(argv[arg] + 11, NULL, 10) : 100000U;
+         benchSynchronizers(0U == cycles ? 1U : cycles);
+         return 0;
        }
       else
        {
-         std::printf("Image format not recognized.\n");
-         std::fclose(file);
+         std::printf("Unrecognized option %s\n", argv[arg]);
+         return 1;
+       }
+    }
+
+   if (NULL != manifest)
+    {
+      if (argc != arg)
+       {
+         std::printf("-batch takes its images from the manifest\n");
          return 1;
        }
+      Batch batch;
+      batch.engine = core.engine;
+      batch.sync = core.sync;
+      batch.limit = core.limit;
+      if (false == batch.read(manifest))
+       {
+         return 1;
+       }
+      timespec began, ended;
+      clock_gettime(CLOCK_MONOTONIC, &began);
+      const size_t failed = batch.run(workers);
+      clock_gettime(CLOCK_MONOTONIC, &ended);
+      std::printf("%lu jobs on %lu workers in %.3f seconds: %lu failed\n", static_cast<unsigned long>(batch.jobs.size()),
+         static_cast<unsigned long>(batch.workers), static_cast<double>(ended.tv_sec - began.tv_sec) + 1e-9 * static_cast<double>(ended.tv_nsec - began.tv_nsec),
+         static_cast<unsigned long>(failed));
+      return (0U == failed) ? 0 : 1;
+    }
+   else if (argc == arg)
+    {
+      HelloWorld(machine);
+      core.doStuff();
+    }
+   else
+    {
+      if (0U != core.checkpoint.interval)
+       {
+         core.checkpoint.start(argv[arg]); // Unless the image is a link of a chain, to carry on
+       }
+      if (false == loadImage(machine, core, argv[arg]))
+       {
+         return 1;
+       }
+      core.doStuff();
     }
 
 //   pthread_t thread;
@@ -146,7 +146,45 @@ MEM_T _xor(COND cond, int source, int lhs, int rhs, int elide = 0, DEST_BELT bel
    return 15 | static_cast<int>(belt) | (static_cast<int>(cond) << 6) | (source << 10) | (lhs << 16) | (rhs << 22) | (elide << 28);
  }
 
-// 16 to 21 are INVALID
+// 16 to 21 are packed: lanes of a word, as the mode (in place of a condition) says
+enum PACKED
+ {
+   P_BYTES    = 0, // Four 8 bit lanes
+   P_HALVES   = 1, // Two 16 bit lanes
+   P_SIGNED   = 2,
+   P_SATURATE = 4, // For padd and psub
+   P_GREATER  = 4  // For pcmp: greater-than rather than equality
+ };
+
+MEM_T padd(int mode, int lhs, int rhs, int elide = 0, DEST_BELT belt = BELT_FAST)
+ {
+   return 16 | static_cast<int>(belt) | (mode << 6) | (lhs << 10) | (rhs << 16) | (elide << 28);
+ }
+
+MEM_T psub(int mode, int lhs, int rhs, int elide = 0, DEST_BELT belt = BELT_FAST)
+ {
+   return 17 | static_cast<int>(belt) | (mode << 6) | (lhs << 10) | (rhs << 16) | (elide << 28);
+ }
+
+MEM_T pcmp(int mode, int lhs, int rhs, int elide = 0, DEST_BELT belt = BELT_FAST)
+ {
+   return 18 | static_cast<int>(belt) | (mode << 6) | (lhs << 10) | (rhs << 16) | (elide << 28);
+ }
+
+MEM_T pmin(int mode, int lhs, int rhs, int elide = 0, DEST_BELT belt = BELT_FAST)
+ {
+   return 19 | static_cast<int>(belt) | (mode << 6) | (lhs << 10) | (rhs << 16) | (elide << 28);
+ }
+
+MEM_T pmax(int mode, int lhs, int rhs, int elide = 0, DEST_BELT belt = BELT_FAST)
+ {
+   return 20 | static_cast<int>(belt) | (mode << 6) | (lhs << 10) | (rhs << 16) | (elide << 28);
+ }
+
+MEM_T pshuf(int lhs, int selectors, int elide = 0, DEST_BELT belt = BELT_FAST)
+ {
+   return 21 | static_cast<int>(belt) | (lhs << 10) | (selectors << 16) | (elide << 28);
+ }
 
 MEM_T addi(int lhs, int imm, int elide = 0, DEST_BELT belt = BELT_FAST)
  {
@@ -283,8 +321,11 @@ MEM_T _int(COND cond, int source, int numargs, int numrets, int elide = 0)
 
 int main (void)
  {
+// ALU SLOTS A CYCLE: 2, 4 or 8
+   int width = 2;
+
    std::FILE * file = std::fopen("prog.prog", "wb");
-   std::fprintf(file, "Mill%s%d Prog    ", endian(), static_cast<int>(sizeof(size_t)));
+   std::fprintf(file, "Mill%s%d%cProg    ", endian(), static_cast<int>(sizeof(size_t)), (2 == width) ? ' ' : '0' + width);
 
 // MEMORY SIZE
    size_t memsize = 43U;
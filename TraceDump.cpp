@@ -0,0 +1,130 @@
+/*
+Copyright (c) 2019, Thomas DiModica
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. Neither the names of the copyright holders nor the names of other
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Print what MillULX -record wrote: TraceDump [MillULX.rec]
+
+#include <cstdio>
+#include <cstring>
+
+typedef long long BELT_T;
+
+static const BELT_T CARRY     =  0x100000000LL;
+static const BELT_T TRANSIENT =  0x200000000LL;
+static const BELT_T INVALID   =  0x400000000LL;
+static const BELT_T OVERFLOW  =  0x800000000LL;
+static const BELT_T ZERO      = 0x1000000000LL;
+
+// As in MillULX's Recorder.
+enum Kind
+ {
+   CYCLE = 1,
+   STORE = 2,
+   DROP_FAST = 3,
+   DROP_SLOW = 4
+ };
+
+class Record
+ {
+public:
+   unsigned int kind;
+   unsigned int a;
+   unsigned long long b;
+ };
+
+static const char* endian()
+ {
+   const short var = 0x454C;
+   return (0 == std::strncmp("LE", static_cast<const char*>(static_cast<const void*>(&var)), 2U)) ? "LE" : "BE";
+ }
+
+static void printValue(const char * belt, BELT_T value)
+ {
+   std::printf("  %s  0x%08llx", belt, static_cast<unsigned long long>(value & 0xFFFFFFFFLL));
+   if (0U != (value & TRANSIENT)) std::printf(" transient");
+   if (0U != (value & INVALID)) std::printf(" invalid");
+   if (0U != (value & CARRY)) std::printf(" carry");
+   if (0U != (value & OVERFLOW)) std::printf(" overflow");
+   if (0U != (value & ZERO)) std::printf(" zero");
+   std::printf("\n");
+ }
+
+int main (int argc, char ** argv)
+ {
+   const char * name = (argc > 1) ? argv[1] : "MillULX.rec";
+   std::FILE * file = std::fopen(name, "rb");
+   if (NULL == file)
+    {
+      std::printf("Cannot open %s\n", name);
+      return 1;
+    }
+   char tag [17];
+   char expected [17];
+   std::snprintf(expected, sizeof(expected), "Mill%s%d Record  ", endian(), static_cast<int>(sizeof(size_t)));
+   unsigned long long header [3];
+   if ((16U != std::fread(tag, 1U, 16U, file)) || (0 != std::memcmp(tag, expected, 16U)) ||
+       (3U != std::fread(static_cast<void*>(header), sizeof(header[0]), 3U, file)))
+    {
+      std::printf("%s isn't a record from this kind of host.\n", name);
+      std::fclose(file);
+      return 1;
+    }
+   const unsigned long long held = header[0];
+   const unsigned long long recorded = header[1];
+   const unsigned long long cycles = header[2];
+   std::printf("%llu records of %llu, written after cycle %llu\n", held, recorded, cycles);
+
+   Record record;
+   for (unsigned long long i = 0U; (i < held) && (1U == std::fread(static_cast<void*>(&record), sizeof(record), 1U, file)); ++i)
+    {
+      switch (record.kind)
+       {
+         case CYCLE:
+          {
+            // Only the low word of the cycle number is kept: the rest comes from the header.
+            const unsigned long long low = record.b & 0xFFFFFFFFU;
+            const unsigned long long number = cycles - ((cycles - low) & 0xFFFFFFFFU);
+            std::printf("cycle %llu  alupc 0x%x  flowpc 0x%llx\n", number, record.a, record.b >> 32);
+          }
+            break;
+         case STORE:
+            std::printf("  store [0x%x] = 0x%08llx\n", record.a, record.b);
+            break;
+         case DROP_FAST:
+            printValue("fast ", static_cast<BELT_T>(record.b));
+            break;
+         case DROP_SLOW:
+            printValue("slow ", static_cast<BELT_T>(record.b));
+            break;
+         default:
+            std::printf("  ? %u\n", record.kind);
+            break;
+       }
+    }
+   std::fclose(file);
+   return 0;
+ }
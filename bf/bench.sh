@@ -0,0 +1,95 @@
+#!/bin/sh
+# Benchmark the execution engines on the bf programs in this directory.
+#
+#   bf/bench.sh [-csv] [engine ...]
+#
+# Builds bfc and MillULX, compiles each program to an image, and runs each
+# image under each engine (inline, threaded, trace and jit, or those named)
+# with -bench. Prints one JSON object a line: the program, and what -bench
+# reports (the engine, guest cycles, wall seconds, cycles per second, and the
+# host instructions per guest cycle where the host will count them). -csv
+# prints the same as CSV, with a header.
+#
+# CXX and CXXFLAGS pick the compiler (g++ -O2), and BENCH_DIR where the builds,
+# images and outputs go (a new temporary directory). Sequence.txt never ends,
+# so it stops after LIMIT cycles (20000000). The threaded engine only manages a
+# few hundred thousand cycles a second, so on it every program stops after
+# THREADED_LIMIT cycles (500000). The output of each run that isn't stopped is
+# checked against the first engine's.
+
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+work=${BENCH_DIR:-$(mktemp -d)}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+LIMIT=${LIMIT:-20000000}
+THREADED_LIMIT=${THREADED_LIMIT:-500000}
+
+csv=no
+if [ "-csv" = "$1" ]; then
+   csv=yes
+   shift
+fi
+engines=${*:-inline threaded trace jit}
+
+mkdir -p "$work"
+$CXX $CXXFLAGS -o "$work/bfc" "$here/bfc.cpp"
+$CXX $CXXFLAGS -o "$work/MillULX" "$here/../MillULX.cpp" -lpthread
+
+if [ yes = $csv ]; then
+   echo "program,engine,cycles,seconds,cycles_per_second,instructions,instructions_per_cycle"
+fi
+
+status=0
+for program in Sequence Sieve Mandelbrot Adventure; do
+   # bfc writes prog.prog, and says on standard output if the compile went bad.
+   (cd "$work" && ./bfc < "$here/$program.txt" > bfc.log && mv prog.prog "$program.img")
+   if [ -s "$work/bfc.log" ]; then
+      echo "bench: bfc can't compile $program.txt" >&2
+      exit 1
+   fi
+   input=/dev/null
+   if [ -f "$here/$program.in" ]; then
+      input=$here/$program.in
+   fi
+
+   reference=
+   for engine in $engines; do
+      limit=
+      if [ Sequence = $program ]; then
+         limit=-limit=$LIMIT
+      fi
+      if [ threaded = $engine ]; then
+         limit=-limit=$THREADED_LIMIT
+      fi
+      out=$work/$program.$engine.out
+      (cd "$work" && ./MillULX -$engine -bench $limit "$program.img" < "$input" > "$out" 2> "$program.$engine.json")
+      result=$(tail -n 1 "$work/$program.$engine.json")
+
+      case "$result" in
+         *"\"engine\": \"$engine\""*) ;;
+         *)
+            echo "bench: no $engine engine in this build" >&2
+            continue
+            ;;
+      esac
+
+      if [ -z "$limit" ]; then
+         if [ -z "$reference" ]; then
+            reference=$engine
+         elif ! cmp -s "$work/$program.$reference.out" "$out"; then
+            echo "bench: $program gives different output under $engine than under $reference" >&2
+            status=1
+         fi
+      fi
+
+      if [ yes = $csv ]; then
+         echo "$program,$(echo "$result" | sed -e 's/"[a-z_]*": //g' -e 's/[{}" ]//g' -e 's/null//g')"
+      else
+         echo "$result" | sed -e "s/^{/{\"program\": \"$program\", /"
+      fi
+   done
+done
+
+exit $status
@@ -668,27 +668,48 @@ size_t compile2(const std::vector<std::vector<Dispatch> >& compiledBlocks, std::
    return entryPoints[0];
  }
 
-static const char* endian()
+static void putLE(std::FILE * file, unsigned long long value, size_t bytes)
  {
-   const short var = 0x454C;
-   return (0 == std::strncmp("LE", static_cast<const char*>(static_cast<const void*>(&var)), 2U)) ? "LE" : "BE";
+   for (size_t i = 0U; i < bytes; ++i)
+    {
+      std::fputc(static_cast<int>((value >> (8U * i)) & 0xFFU), file);
+    }
  }
 
-void dumpBin(size_t entry, const std::vector<int>& data)
+// Write image format 2: a zero-fill section for the tape, and a data section for the code
+// at a file offset congruent to its address modulo 4096, so that MillULX can map it.
+static const size_t IMAGE_PAGE = 4096U;
+
+void dumpBin(size_t entry, const std::vector<int>& data, size_t tape)
  {
    std::FILE * file = std::fopen("prog.prog", "wb");
-   std::fprintf(file, "Mill%s%d Prog    ", endian(), static_cast<int>(sizeof(size_t)));
-
-   size_t memsize = data.size();
-   size_t numBlocks = 1U;
-   size_t blockEntry = 0U;
-
-   std::fwrite(static_cast<void*>(&memsize), sizeof(size_t), 1, file);
-   std::fwrite(static_cast<void*>(&entry), sizeof(size_t), 1, file);
-   std::fwrite(static_cast<void*>(&numBlocks), sizeof(size_t), 1, file);
-   std::fwrite(static_cast<void*>(&blockEntry), sizeof(size_t), 1, file);
-   std::fwrite(static_cast<void*>(&memsize), sizeof(size_t), 1, file);
-   std::fwrite(static_cast<const void*>(&data[0U]), sizeof(int), memsize, file);
+   std::fprintf(file, "MillImg2");
+   putLE(file, 2U, 4U); // version
+   putLE(file, 2U, 4U); // sections
+   putLE(file, data.size(), 8U);
+   putLE(file, entry, 8U);
+
+   // After the header and the section table, at the same offset into a page as the code's address.
+   const size_t code = IMAGE_PAGE + (tape * sizeof(int)) % IMAGE_PAGE;
+   putLE(file, 2U, 4U); // zero
+   putLE(file, 0U, 4U);
+   putLE(file, 0U, 8U);
+   putLE(file, tape, 8U);
+   putLE(file, 0U, 8U);
+   putLE(file, 1U, 4U); // data
+   putLE(file, 0U, 4U);
+   putLE(file, tape, 8U);
+   putLE(file, data.size() - tape, 8U);
+   putLE(file, code, 8U);
+
+   for (size_t pad = 32U + 2U * 32U; pad < code; ++pad)
+    {
+      std::fputc(0, file);
+    }
+   for (size_t i = tape; i < data.size(); ++i)
+    {
+      putLE(file, static_cast<unsigned int>(data[i]), 4U);
+    }
 
    std::fclose(file);
  }
@@ -748,10 +769,11 @@ int main (void)
 
    std::vector<int> memory;
    // The first 8K words (32K bytes) are the tape of zeros.
-   memory.resize(8192);
+   const size_t tape = 8192U;
+   memory.resize(tape);
    size_t entry = compile2(compiledBlocks, memory, deps);
 
-   dumpBin(entry, memory);
+   dumpBin(entry, memory, tape);
 
    return 0;
  }